@@ -1,17 +0,0 @@
-# #############################################################################
-# UberSaw Project Customization
-# #############################################################################
-
-PROJECT = ubersaw_v1.0
-
-UCSRC = 
-
-UCXXSRC = ubersaw_v1.0.cpp
-
-UINCDIR =
-
-UDEFS =
-
-ULIB = 
-
-ULIBDIR =
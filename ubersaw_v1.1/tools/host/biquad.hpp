@@ -0,0 +1,53 @@
+/*
+ * File: biquad.hpp (host shim)
+ *
+ * The part of the logue-sdk dsp::BiQuad the engine uses: the
+ * one-pole high pass set up by setPoleHP() and run by
+ * process_fo(), with the same state layout.
+ *
+ */
+
+#pragma once
+
+namespace dsp {
+
+	struct BiQuad {
+
+		struct Coeffs {
+			float ff0, ff1, ff2, fb1, fb2;
+
+			Coeffs(void) :
+				ff0(0), ff1(0), ff2(0), fb1(0), fb2(0)
+			{ }
+
+			inline void setPoleHP(const float pole) {
+				ff0 = 0.5f * (1.f + pole);
+				ff1 = -ff0;
+				ff2 = 0;
+				fb1 = -pole;
+				fb2 = 0;
+			}
+		};
+
+		BiQuad(void) :
+			mZ1(0), mZ2(0)
+		{ }
+
+		inline void flush(void) {
+			mZ1 = mZ2 = 0;
+		}
+
+		// First order section (ff0, ff1, fb1)
+
+		inline float process_fo(const float xn) {
+			float acc = mCoeffs.ff0 * xn + mZ1;
+			mZ1 = mCoeffs.ff1 * xn;
+			mZ1 -= mCoeffs.fb1 * acc;
+			return acc;
+		}
+
+		Coeffs 	mCoeffs;
+		float 	mZ1, mZ2;
+	};
+
+}
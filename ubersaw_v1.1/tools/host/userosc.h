@@ -0,0 +1,148 @@
+/*
+ * File: userosc.h (host shim)
+ *
+ * Stand-in for the logue-sdk user oscillator headers on the
+ * build machine. It declares the OSC_* hooks and provides the
+ * subset of osc_api.h, float_math.h and int_math.h the engine
+ * and the host tools use. Functions the firmware implements
+ * with lookup tables (note pitches, sine) are computed in
+ * closed form, so host figures are close to, but not bit for
+ * bit the same as, the synth.
+ *
+ * Build host tools with -Itools/host, or point HOST_INC at the
+ * SDK headers and HOST_API at sources providing the firmware
+ * tables to build against the SDK instead.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// =========================================================
+// Runtime types and constants (userosc.h, osc_api.h)
+// =========================================================
+
+typedef int32_t q31_t;
+
+typedef struct user_osc_param {
+	int32_t 	shape_lfo;		// LFO value applied to the shape parameter (Q31)
+	uint16_t 	pitch;			// High byte: note number, low byte: fine (0-255)
+	uint16_t 	cutoff;
+	uint16_t 	resonance;
+	uint16_t 	reserved0[3];
+} user_osc_param_t;
+
+enum {
+	k_user_osc_param_id1 = 0,
+	k_user_osc_param_id2,
+	k_user_osc_param_id3,
+	k_user_osc_param_id4,
+	k_user_osc_param_id5,
+	k_user_osc_param_id6,
+	k_user_osc_param_shape,
+	k_user_osc_param_shiftshape,
+	k_num_user_osc_param_id
+};
+
+#define k_samplerate 			(48000)
+#define k_samplerate_recipf 	(2.08333333333333e-005f)
+
+#define k_midi_to_hz_size 		(152)
+#define k_note_mod_fscale 		(0.00392156862745098f)
+#define k_note_max_hz 			(23679.643054f)
+
+// =========================================================
+// Oscillator hooks
+// =========================================================
+
+void OSC_INIT(uint32_t platform, uint32_t api);
+void OSC_CYCLE(const user_osc_param_t *const params, int32_t *yn, const uint32_t frames);
+void OSC_NOTEON(const user_osc_param_t *const params);
+void OSC_NOTEOFF(const user_osc_param_t *const params);
+void OSC_PARAM(uint16_t index, uint16_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define __fast_inline 	static inline
+
+// =========================================================
+// Fixed point conversion (fixed_math.h)
+// =========================================================
+
+#define q31_to_f32(q) 	((float)(q) * 4.65661287307739e-010f)
+#define f32_to_q31(f) 	((q31_t)((float)(f) * (float)0x7FFFFFFF))
+
+#define param_val_to_f32(val) 	((uint16_t)(val) * 9.77517106549365e-004f)
+
+// =========================================================
+// Clipping and interpolation (float_math.h, int_math.h)
+// =========================================================
+
+__fast_inline float clipmaxf(const float x, const float m) {
+	return (x >= m) ? m : x;
+}
+
+__fast_inline float clipminmaxf(const float m, const float x, const float M) {
+	return (x >= M) ? M : (x <= m) ? m : x;
+}
+
+__fast_inline float clip01f(const float x) {
+	return (x > 1.f) ? 1.f : (x < 0.f) ? 0.f : x;
+}
+
+__fast_inline float clip1m1f(const float x) {
+	return (x > 1.f) ? 1.f : (x < -1.f) ? -1.f : x;
+}
+
+__fast_inline uint32_t clipmaxu32(const uint32_t x, const uint32_t m) {
+	return (x >= m) ? m : x;
+}
+
+__fast_inline uint32_t clipminmaxu32(const uint32_t m, const uint32_t x, const uint32_t M) {
+	return (x >= M) ? M : (x <= m) ? m : x;
+}
+
+__fast_inline float si_fabsf(const float x) {
+	return fabsf(x);
+}
+
+__fast_inline float linintf(const float fr, const float x0, const float x1) {
+	return x0 + fr * (x1 - x0);
+}
+
+// =========================================================
+// Oscillator helpers (osc_api.h)
+// =========================================================
+
+__fast_inline float osc_notehzf(const uint8_t note) {
+	return 440.f * powf(2.f, ((int32_t)clipmaxu32(note, k_midi_to_hz_size - 1) - 69) / 12.f);
+}
+
+__fast_inline float osc_w0f_for_note(const uint8_t note, const uint8_t mod) {
+	const float f0 = osc_notehzf(note);
+	const float f1 = osc_notehzf(note + 1);
+	const float f = clipmaxf(linintf(mod * k_note_mod_fscale, f0, f1), k_note_max_hz);
+	return f * k_samplerate_recipf;
+}
+
+__fast_inline float osc_sinf(const float x) {
+	return sinf(6.283185307179586f * (x - (uint32_t)x));
+}
+
+__fast_inline float osc_sawf(const float x) {
+	return 2.f * (x - (uint32_t)x) - 1.f;
+}
+
+__fast_inline float osc_softclipf(const float c, float x) {
+	x = clip1m1f(x);
+	return x - c * (x * x * x);
+}
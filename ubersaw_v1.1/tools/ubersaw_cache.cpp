@@ -0,0 +1,385 @@
+/*
+ * File: ubersaw_cache.cpp
+ *
+ * Memory mapped render cache for host builds (POSIX).
+ *
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "userosc.h"
+#include "ubersaw_cache.hpp"
+
+// =========================================================
+// FNV-1a, 64 bit
+// =========================================================
+
+#define FNV_OFFSET 	0xCBF29CE484222325ull
+#define FNV_PRIME 	0x00000100000001B3ull
+
+static inline void hashBytes(uint64_t &h, const void *data, uint32_t size) {
+	const uint8_t *p = (const uint8_t *)data;
+	for(uint32_t i = 0; i < size; i++) {
+		h ^= p[i];
+		h *= FNV_PRIME;
+	}
+}
+
+static inline void hashFloat(uint64_t &h, const float x) {
+	hashBytes(h, &x, sizeof(x));
+}
+
+static inline void hashWord(uint64_t &h, const uint64_t x) {
+	hashBytes(h, &x, sizeof(x));
+}
+
+// =========================================================
+// Render size in bytes
+// =========================================================
+
+static inline uint64_t renderBytes(uint32_t frames, uint32_t format) {
+	return (uint64_t)frames * (format == k_cache_f32_stereo ? 2 * sizeof(float) : sizeof(q31_t));
+}
+
+RenderCache::RenderCache(void) :
+	header(NULL),
+	arena(NULL),
+	mapped(0),
+	fd(-1),
+	pending(NULL),
+	pending_key(0)
+{
+	memset(&counters, 0, sizeof(counters));
+}
+
+RenderCache::~RenderCache(void) {
+	close();
+}
+
+/* // =========================================================
+* Map the cache file. A file written with the same layout and
+* capacity keeps its index, anything else starts empty.
+*/ // =========================================================
+
+bool RenderCache::open(const char *path, uint64_t capacity) {
+
+	close();
+
+	fd = ::open(path, O_RDWR | O_CREAT, 0644);
+	if(fd < 0) {
+		return false;
+	}
+
+	mapped = sizeof(CacheHeader) + capacity;
+
+	struct stat st;
+	const bool reuse = fstat(fd, &st) == 0 && (uint64_t)st.st_size == mapped;
+	if(!reuse && ftruncate(fd, (off_t)mapped) != 0) {
+		close();
+		return false;
+	}
+
+	void *base = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(base == MAP_FAILED) {
+		close();
+		return false;
+	}
+
+	header = (CacheHeader *)base;
+	arena = (uint8_t *)base + sizeof(CacheHeader);
+
+	if(!reuse || header->magic != CACHE_MAGIC || header->layout != CACHE_LAYOUT
+			|| header->capacity != capacity) {
+		memset(header, 0, sizeof(CacheHeader));
+		header->magic = CACHE_MAGIC;
+		header->layout = CACHE_LAYOUT;
+		header->capacity = capacity;
+	}
+
+	return true;
+}
+
+void RenderCache::close(void) {
+	if(header) {
+		munmap(header, mapped);
+	}
+	if(fd >= 0) {
+		::close(fd);
+	}
+	header = NULL;
+	arena = NULL;
+	mapped = 0;
+	fd = -1;
+	pending = NULL;
+	pending_key = 0;
+}
+
+/* // =========================================================
+* Sound configuration of u: what render() copies onto a fresh
+* engine. Everything else (phases, filter, LFO phases, ramps,
+* envelope and tier) is live state and starts from scratch.
+*/ // =========================================================
+
+static void copyConfig(UberSaw &voice, const UberSaw &u) {
+
+	voice.params = u.params;
+	voice.state.interval = u.state.interval;
+	voice.env.attack = u.env.attack;
+	voice.env.release = u.env.release;
+	voice.dither_bits = u.dither_bits;
+
+	for(int i = 0; i < NUM_LFO; i++) {
+		voice.mod.lfo[i].w0 = u.mod.lfo[i].w0;
+		voice.mod.lfo[i].wave = u.mod.lfo[i].wave;
+		for(int j = 0; j < k_num_mod_dest; j++) {
+			voice.mod.depth[i][j] = u.mod.depth[i][j];
+		}
+	}
+
+	for(int i = 0; i < NUM_OSC; i++) {
+		voice.state.pan_L[i] = u.state.pan_L[i];
+		voice.state.pan_R[i] = u.state.pan_R[i];
+	}
+}
+
+/* // =========================================================
+* Content key: the engine version, the configuration copyConfig()
+* renders with and the render request. extra folds in anything
+* else the caller's renders depend on.
+*/ // =========================================================
+
+uint64_t RenderCache::key(const UberSaw &u, uint16_t pitch, uint32_t frames, uint32_t format,
+		uint32_t seed, uint64_t extra) {
+
+	const UberSaw::Params &p = u.params;
+
+	uint64_t h = FNV_OFFSET;
+	hashWord(h, UBERSAW_ENGINE_VERSION);
+	hashFloat(h, p.mix_A);
+	hashFloat(h, p.mix_B);
+	hashFloat(h, p.ringmix);
+	hashFloat(h, p.detune);
+	hashFloat(h, p.shape);
+	hashFloat(h, p.shiftshape);
+	hashFloat(h, p.fm);
+	hashWord(h, p.sync);
+	hashWord(h, p.chord);
+	hashWord(h, p.phase);
+	hashFloat(h, u.state.interval.ratio);
+	hashFloat(h, u.state.interval.recip);
+	hashFloat(h, u.env.attack);
+	hashFloat(h, u.env.release);
+	hashWord(h, u.dither_bits);
+	for(int i = 0; i < NUM_LFO; i++) {
+		hashFloat(h, u.mod.lfo[i].w0);
+		hashWord(h, u.mod.lfo[i].wave);
+		for(int j = 0; j < k_num_mod_dest; j++) {
+			hashFloat(h, u.mod.depth[i][j]);
+		}
+	}
+	for(int i = 0; i < NUM_OSC; i++) {
+		hashFloat(h, u.state.pan_L[i]);
+		hashFloat(h, u.state.pan_R[i]);
+	}
+	hashWord(h, pitch);
+	hashWord(h, frames);
+	hashWord(h, format);
+	hashWord(h, seed);
+	hashWord(h, extra);
+
+	return h ? h : 1; 	// 0 marks a free slot
+}
+
+const void *RenderCache::find(uint64_t key, uint32_t *frames) {
+
+	if(header) {
+		for(int i = 0; i < CACHE_ENTRIES; i++) {
+			CacheEntry &e = header->entries[i];
+			if(__atomic_load_n(&e.key, __ATOMIC_ACQUIRE) == key) {
+				e.used = ++header->tick;
+				counters.hits++;
+				counters.bytes_served += e.bytes;
+				if(frames) {
+					*frames = e.frames;
+				}
+				return arena + e.offset;
+			}
+		}
+	}
+
+	counters.misses++;
+	return NULL;
+}
+
+/* // =========================================================
+* First fit: the lowest gap between live renders (in offset
+* order) that holds bytes.
+*/ // =========================================================
+
+bool RenderCache::fits(uint64_t bytes, uint64_t *offset) const {
+
+	uint64_t start = 0;
+	for(;;) {
+
+		// Next live render at or after start
+
+		const CacheEntry *next = NULL;
+		for(int i = 0; i < CACHE_ENTRIES; i++) {
+			const CacheEntry &e = header->entries[i];
+			if(e.key && e.offset + e.bytes > start && (!next || e.offset < next->offset)) {
+				next = &e;
+			}
+		}
+
+		const uint64_t end = next ? next->offset : header->capacity;
+		if(end >= start + bytes) {
+			*offset = start;
+			return true;
+		}
+		if(!next) {
+			return false;
+		}
+
+		start = (next->offset + next->bytes + CACHE_ALIGN - 1) & ~(uint64_t)(CACHE_ALIGN - 1);
+	}
+}
+
+bool RenderCache::evictOldest(void) {
+
+	CacheEntry *oldest = NULL;
+	for(int i = 0; i < CACHE_ENTRIES; i++) {
+		CacheEntry &e = header->entries[i];
+		if(e.key && (!oldest || e.used < oldest->used)) {
+			oldest = &e;
+		}
+	}
+
+	if(!oldest) {
+		return false;
+	}
+
+	__atomic_store_n(&oldest->key, 0, __ATOMIC_RELEASE);
+	memset(oldest, 0, sizeof(CacheEntry));
+	counters.evictions++;
+	return true;
+}
+
+/* // =========================================================
+* Reserve a render. The slot is filled in but its key is left
+* at 0 (free to find()) until commit(), so a reader of the
+* mapping never sees a key whose samples are still being
+* written. Only one insert may be pending.
+*/ // =========================================================
+
+void *RenderCache::insert(uint64_t key, uint32_t frames, uint32_t format) {
+
+	pending = NULL;
+	pending_key = 0;
+
+	const uint64_t bytes = renderBytes(frames, format);
+	if(!header || bytes == 0 || bytes > header->capacity) {
+		return NULL;
+	}
+
+	// =========================================================
+	// A free index slot, evicting the oldest render if needed
+	// =========================================================
+
+	CacheEntry *slot = NULL;
+	for(;;) {
+		for(int i = 0; i < CACHE_ENTRIES && !slot; i++) {
+			if(!header->entries[i].key) {
+				slot = &header->entries[i];
+			}
+		}
+		if(slot || !evictOldest()) {
+			break;
+		}
+	}
+
+	// =========================================================
+	// Arena space, evicting the oldest renders until it fits
+	// =========================================================
+
+	uint64_t offset = 0;
+	while(!fits(bytes, &offset)) {
+		if(!evictOldest()) {
+			return NULL;
+		}
+	}
+
+	slot->offset = offset;
+	slot->bytes = bytes;
+	slot->frames = frames;
+	slot->format = format;
+	slot->used = ++header->tick;
+
+	pending = slot;
+	pending_key = key;
+	return arena + offset;
+}
+
+/* // =========================================================
+* Publish the pending render once its samples are written:
+* the key is stored last, with release ordering.
+*/ // =========================================================
+
+void RenderCache::commit(void) {
+	if(pending) {
+		__atomic_store_n(&pending->key, pending_key, __ATOMIC_RELEASE);
+		pending = NULL;
+		pending_key = 0;
+	}
+}
+
+/* // =========================================================
+* Serve a render from the cache. On a miss, render a copy of
+* the clean engine built with the cache, given u's configuration
+* and the seed (u itself is untouched and its live state plays
+* no part), from note on straight into the mapping, then
+* publish it. No engine is constructed here, so render() does
+* not write the shared detune table.
+*/ // =========================================================
+
+const void *RenderCache::render(const UberSaw &u, uint16_t pitch, uint32_t frames,
+		uint32_t format, uint32_t seed, uint64_t extra) {
+
+	const uint64_t k = key(u, pitch, frames, format, seed, extra);
+
+	const void *hit = find(k, NULL);
+	if(hit) {
+		return hit;
+	}
+
+	void *out = insert(k, frames, format);
+	if(!out) {
+		return NULL;
+	}
+
+	UberSaw voice = pristine;
+	copyConfig(voice, u);
+	voice.seed(seed);
+	ubersaw_note_on(voice);
+
+	user_osc_param_t params;
+	memset(&params, 0, sizeof(params));
+	params.pitch = pitch;
+
+	for(uint32_t pos = 0; pos < frames; pos += OUTPUT_BLOCK) {
+		const uint32_t n = (frames - pos < OUTPUT_BLOCK) ? frames - pos : OUTPUT_BLOCK;
+		if(format == k_cache_f32_stereo) {
+			float *y = (float *)out + 2 * pos;
+			ubersaw_cycle_stereo(voice, &params, y, y + 1, 2, n);
+		}
+		else {
+			ubersaw_cycle(voice, &params, (q31_t *)out + pos, n);
+		}
+	}
+
+	commit();
+	return out;
+}
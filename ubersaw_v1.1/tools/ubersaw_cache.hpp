@@ -0,0 +1,122 @@
+/*
+ * File: ubersaw_cache.hpp
+ *
+ * Content addressed render cache for host builds. Rendered
+ * blocks live in a memory mapped file with an index, so a
+ * repeated render of the same sound is served straight from
+ * the mapping. The least recently used renders are evicted
+ * to stay under the size cap.
+ *
+ */
+
+#pragma once
+
+#include "../ubersaw_v1.1.hpp"
+
+// =========================================================
+// Cache file layout
+// =========================================================
+
+#define CACHE_MAGIC 		0x55534331u 	// "USC1"
+#define CACHE_LAYOUT 		2 				// Bump when the file layout or key changes
+#define CACHE_ENTRIES 		256 			// Index slots
+#define CACHE_ALIGN 		64 				// Render alignment in the arena (bytes)
+
+enum {
+	k_cache_q31 = 0, 		// Mono Q31, as OSC_CYCLE
+	k_cache_f32_stereo, 	// Interleaved float, as ubersaw_cycle_stereo
+	k_num_cache_formats
+};
+
+// =========================================================
+// One cached render
+// =========================================================
+
+struct CacheEntry {
+	uint64_t 	key;		// Content hash, 0 = free slot
+	uint64_t 	offset;		// Byte offset into the arena
+	uint64_t 	bytes;		// Render size
+	uint64_t 	used;		// Tick of the last hit or insert
+	uint32_t 	frames;		// Frames rendered
+	uint32_t 	format;		// k_cache_*
+};
+
+// =========================================================
+// File header, followed by the index and the arena
+// =========================================================
+
+struct CacheHeader {
+	uint32_t 	magic;
+	uint32_t 	layout;
+	uint64_t 	capacity;	// Arena size (bytes)
+	uint64_t 	tick;		// LRU clock
+	CacheEntry 	entries[CACHE_ENTRIES];
+};
+
+// =========================================================
+// Hit and miss counters (this process)
+// =========================================================
+
+struct CacheStats {
+	uint32_t 	hits;
+	uint32_t 	misses;
+	uint32_t 	evictions;
+	uint64_t 	bytes_served;	// Bytes returned from the mapping
+};
+
+/* // =========================================================
+* The cache. Pointers returned by find() and render() point
+* into the mapping and stay valid until the next insert, which
+* may evict them. A cache is used from one thread at a time.
+* It holds a clean engine, so construct caches before starting
+* render threads (the constructor fills the shared detune table).
+*/ // =========================================================
+
+class RenderCache {
+public:
+	RenderCache(void);
+	~RenderCache(void);
+
+	// Map (and create or resize) the cache file with an arena of capacity bytes
+	bool open(const char *path, uint64_t capacity);
+	void close(void);
+
+	// Key of a render of u's current sound
+	static uint64_t key(const UberSaw &u, uint16_t pitch, uint32_t frames, uint32_t format,
+			uint32_t seed, uint64_t extra);
+
+	// Cached render for key, or NULL
+	const void *find(uint64_t key, uint32_t *frames);
+
+	// Reserve space for a render of frames, evicting as needed; NULL if it cannot fit
+	void *insert(uint64_t key, uint32_t frames, uint32_t format);
+
+	// Publish the render reserved by the last insert, once it is written
+	void commit(void);
+
+	// Serve a render of u's current sound from the cache, rendering it on a miss
+	const void *render(const UberSaw &u, uint16_t pitch, uint32_t frames, uint32_t format,
+			uint32_t seed, uint64_t extra = 0);
+
+	// Byte offset in the cache file of a render returned by find() or render()
+	uint64_t fileOffset(const void *render) const {
+		return (uint64_t)((const uint8_t *)render - (const uint8_t *)header);
+	}
+
+	const CacheStats &stats(void) const {
+		return counters;
+	}
+
+private:
+	bool fits(uint64_t bytes, uint64_t *offset) const;
+	bool evictOldest(void);
+
+	CacheHeader *header;
+	uint8_t 	*arena;
+	uint64_t 	mapped;
+	int 		fd;
+	CacheStats 	counters;
+	CacheEntry 	*pending;		// Reserved by insert(), published by commit()
+	uint64_t 	pending_key;
+	UberSaw 	pristine;		// Clean engine, copied for each render
+};
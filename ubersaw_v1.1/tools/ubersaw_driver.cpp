@@ -0,0 +1,461 @@
+/*
+ * File: ubersaw_driver.cpp
+ *
+ * Realtime host driver for the oscillator (Linux). An audio
+ * thread runs OSC_CYCLE from a period callback, as an ALSA or
+ * JACK process callback would, and MIDI input drives
+ * OSC_NOTEON, OSC_NOTEOFF and, through midi_map, OSC_PARAM.
+ *
+ * The backend is a null device: a SCHED_FIFO thread (when
+ * permitted) that wakes on an absolute clock every period and
+ * discards the output, so it runs on machines without a sound
+ * card. Memory is locked with mlockall() and every buffer is
+ * static; operator new counts any allocation made inside the
+ * callback.
+ *
+ * It runs at periods of 32, 64 and 128 frames in turn and
+ * prints, for each, a histogram of the callback time as a share
+ * of the period, the wake-up lateness, the xruns and the
+ * headroom left. With --freerun it does not wait for the next
+ * period, so CI machines get the callback timings quickly.
+ *
+ * MIDI comes from a raw MIDI device or file (--midi, e.g.
+ * /dev/snd/midiC1D0) or, by default, a built-in sequence of
+ * notes and CC sweeps over the mapped controllers.
+ *
+ * Usage: ubersaw_driver [-s seconds per period] [--midi <device>]
+ *                       [--freerun]
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <new>
+#include <thread>
+
+#include "userosc.h"
+#include "../ubersaw_v1.1.hpp"
+
+// =========================================================
+// Settings
+// =========================================================
+
+#define SAMPLERATE 		48000
+#define MAX_PERIOD 		128
+#define HIST_BINS 		21 			// 5% of the period each, the last is >= 100% (xrun)
+#define WAKE_BINS 		24 			// Power of two microsecond bins
+#define MIDI_RING 		1024 		// Bytes (power of two)
+#define STACK_PREFAULT 	(64 * 1024)
+#define RT_PRIORITY 	70
+
+static const uint32_t periods[] = { 32, 64, 128 };
+
+#define NUM_PERIODS 	(sizeof(periods) / sizeof(periods[0]))
+
+static inline uint64_t nowNs(void) {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* // =========================================================
+* Allocation check. operator new counts calls made while the
+* audio thread is inside the callback.
+*/ // =========================================================
+
+static thread_local bool in_callback = false;
+static std::atomic<uint32_t> callback_allocs(0);
+
+void *operator new(size_t size) {
+	if(in_callback) {
+		callback_allocs++;
+	}
+	void *p = malloc(size ? size : 1);
+	if(!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	free(p);
+}
+
+/* // =========================================================
+* MIDI byte ring, one producer (the MIDI thread) and one
+* consumer (the callback).
+*/ // =========================================================
+
+struct MidiRing {
+	uint8_t 	bytes[MIDI_RING];
+	uint32_t 	head;	// Consumer
+	uint32_t 	tail;	// Producer
+
+	inline bool push(uint8_t b) {
+		if(tail - __atomic_load_n(&head, __ATOMIC_ACQUIRE) >= MIDI_RING) {
+			return false;
+		}
+		bytes[tail & (MIDI_RING - 1)] = b;
+		__atomic_store_n(&tail, tail + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	inline bool pop(uint8_t *b) {
+		if(head == __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) {
+			return false;
+		}
+		*b = bytes[head & (MIDI_RING - 1)];
+		__atomic_store_n(&head, head + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+};
+
+static MidiRing midi;
+static std::atomic<bool> running(true);
+
+/* // =========================================================
+* MIDI parser, run in the callback. Omni, with running status;
+* realtime bytes are skipped and SysEx is dropped.
+*/ // =========================================================
+
+struct MidiIn {
+	uint8_t 	status;
+	uint8_t 	data[2];
+	uint8_t 	count;
+	uint8_t 	note;		// Sounding note
+	bool 		sysex;
+	uint32_t 	notes;		// Note ons applied
+	uint32_t 	ccs;		// Mapped CCs applied
+};
+
+static MidiIn midi_in;
+
+static void applyMessage(user_osc_param_t &params) {
+
+	const uint8_t type = midi_in.status & 0xF0;
+	const uint8_t d0 = midi_in.data[0];
+	const uint8_t d1 = midi_in.data[1];
+
+	if(type == 0x90 && d1) {
+		midi_in.note = d0;
+		params.pitch = (uint16_t)(d0 << 8);
+		OSC_NOTEON(&params);
+		midi_in.notes++;
+	}
+	else if((type == 0x80 || type == 0x90) && d0 == midi_in.note) {
+		OSC_NOTEOFF(&params);
+	}
+	else if(type == 0xB0) {
+		for(uint32_t i = 0; i < sizeof(midi_map) / sizeof(midi_map[0]); i++) {
+			if(midi_map[i].cc == d0) {
+				OSC_PARAM(midi_map[i].index, midiMapValue(midi_map[i], d1));
+				midi_in.ccs++;
+			}
+		}
+	}
+}
+
+static void pollMidi(user_osc_param_t &params) {
+	uint8_t b;
+	while(midi.pop(&b)) {
+		if(b >= 0xF8) {
+			continue; 			// Realtime
+		}
+		if(b >= 0x80) {
+			midi_in.sysex = (b == 0xF0);
+			midi_in.status = (b < 0xF0) ? b : 0;
+			midi_in.count = 0;
+			continue;
+		}
+		if(midi_in.sysex || !midi_in.status) {
+			continue;
+		}
+		midi_in.data[midi_in.count++] = b;
+		const uint8_t type = midi_in.status & 0xF0;
+		const uint8_t size = (type == 0xC0 || type == 0xD0) ? 1 : 2;
+		if(midi_in.count == size) {
+			applyMessage(params);
+			midi_in.count = 0;
+		}
+	}
+}
+
+/* // =========================================================
+* MIDI sources: a raw MIDI device or file, or a built-in
+* sequence of a note every 250ms and a step of a CC sweep
+* every 10ms, cycling through the mapped controllers.
+*/ // =========================================================
+
+static void readMidi(int fd) {
+	uint8_t buf[64];
+	while(running) {
+		const ssize_t n = read(fd, buf, sizeof(buf));
+		if(n <= 0) {
+			break;
+		}
+		for(ssize_t i = 0; i < n; i++) {
+			while(!midi.push(buf[i]) && running) {
+				usleep(1000);
+			}
+		}
+	}
+	close(fd);
+}
+
+static void sequenceMidi(void) {
+	static const uint8_t notes[] = { 36, 48, 55, 60, 67, 72, 79, 84 };
+	uint32_t tick = 0;
+	while(running) {
+		if(tick % 25 == 0) {
+			const uint8_t note = notes[(tick / 25) % sizeof(notes)];
+			midi.push(0x90);
+			midi.push(note);
+			midi.push(100);
+		}
+		else if(tick % 25 == 20) {
+			midi.push(0x80);
+			midi.push(notes[(tick / 25) % sizeof(notes)]);
+			midi.push(0);
+		}
+		const MidiMap &m = midi_map[(tick / 128) % (sizeof(midi_map) / sizeof(midi_map[0]))];
+		midi.push(0xB0);
+		midi.push(m.cc);
+		midi.push((uint8_t)(tick & 0x7F));
+		tick++;
+		usleep(10000);
+	}
+}
+
+/* // =========================================================
+* Timings of one period size.
+*/ // =========================================================
+
+struct Timing {
+	uint32_t 	frames;
+	uint32_t 	callbacks;
+	uint32_t 	xruns;			// Callbacks that finished after the next deadline
+	uint32_t 	hist[HIST_BINS];	// Callback time, 5% of the period per bin
+	uint32_t 	wake[WAKE_BINS];	// Wake-up lateness, bin i: [2^i, 2^(i+1)) us
+	uint64_t 	total_ns;
+	uint64_t 	max_ns;
+	uint64_t 	wake_max_ns;
+	uint64_t 	response_max_ns;	// Deadline to end of callback, lateness included
+};
+
+static Timing timings[NUM_PERIODS];
+
+// Upper edge of the histogram bin holding quantile q
+
+static uint32_t quantileBin(const uint32_t *hist, uint32_t bins, uint32_t count, double q) {
+	const uint32_t rank = (uint32_t)(q * count + 0.5);
+	uint32_t seen = 0;
+	for(uint32_t i = 0; i < bins; i++) {
+		seen += hist[i];
+		if(seen >= rank && seen) {
+			return i;
+		}
+	}
+	return bins - 1;
+}
+
+/* // =========================================================
+* The period callback: MIDI in, then OSC_CYCLE in blocks of
+* up to OUTPUT_BLOCK frames as the synth calls it. No locks,
+* no allocation, no system calls.
+*/ // =========================================================
+
+static void callback(user_osc_param_t &params, int32_t *out, uint32_t frames) {
+	pollMidi(params);
+	for(uint32_t pos = 0; pos < frames; pos += OUTPUT_BLOCK) {
+		const uint32_t n = (frames - pos < OUTPUT_BLOCK) ? frames - pos : OUTPUT_BLOCK;
+		OSC_CYCLE(&params, out + pos, n);
+	}
+}
+
+// =========================================================
+// Null backend: the audio thread
+// =========================================================
+
+static void audioThread(double seconds, bool freerun) {
+
+	// Touch the stack the callback will use while memory is locked
+
+	volatile uint8_t stack[STACK_PREFAULT];
+	memset((void *)stack, 0, sizeof(stack));
+
+	static int32_t out[MAX_PERIOD];
+	static user_osc_param_t params;
+	memset(&params, 0, sizeof(params));
+	params.pitch = 60 << 8;
+
+	for(uint32_t p = 0; p < NUM_PERIODS; p++) {
+
+		Timing &t = timings[p];
+		t.frames = periods[p];
+
+		const uint64_t period_ns = (uint64_t)t.frames * 1000000000ull / SAMPLERATE;
+		const uint32_t count = (uint32_t)(seconds * SAMPLERATE / t.frames);
+		uint64_t deadline = nowNs() + period_ns;
+
+		for(uint32_t c = 0; c < count; c++) {
+
+			if(!freerun) {
+				timespec ts = { (time_t)(deadline / 1000000000ull), (long)(deadline % 1000000000ull) };
+				while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) { }
+			}
+
+			const uint64_t start = nowNs();
+			in_callback = true;
+			callback(params, out, t.frames);
+			in_callback = false;
+			const uint64_t end = nowNs();
+
+			const uint64_t took = end - start;
+			uint32_t bin = (uint32_t)(took * (HIST_BINS - 1) / period_ns);
+			t.hist[bin < HIST_BINS ? bin : HIST_BINS - 1]++;
+			t.total_ns += took;
+			t.max_ns = (took > t.max_ns) ? took : t.max_ns;
+			t.callbacks++;
+
+			if(!freerun) {
+				const uint64_t late = (start > deadline) ? start - deadline : 0;
+				uint32_t w = 0;
+				while(w < WAKE_BINS - 1 && ((late / 1000) >> (w + 1))) {
+					w++;
+				}
+				t.wake[w]++;
+				t.wake_max_ns = (late > t.wake_max_ns) ? late : t.wake_max_ns;
+				const uint64_t response = end - (deadline < start ? deadline : start);
+				t.response_max_ns = (response > t.response_max_ns) ? response : t.response_max_ns;
+
+				deadline += period_ns;
+				if(end > deadline) {
+					t.xruns++;
+					deadline = end + period_ns; 	// Skip the missed period
+				}
+			}
+			else if(took > period_ns) {
+				t.xruns++;
+			}
+		}
+	}
+}
+
+// =========================================================
+// Report
+// =========================================================
+
+static void printTiming(const Timing &t, bool freerun) {
+
+	const double period_us = t.frames * 1e6 / SAMPLERATE;
+	const double mean_us = t.callbacks ? t.total_ns * 1e-3 / t.callbacks : 0.;
+	const double max_us = t.max_ns * 1e-3;
+	const uint32_t p99 = quantileBin(t.hist, HIST_BINS, t.callbacks, 0.99);
+
+	printf("\nperiod %u frames (%.0fus), %u callbacks, %u xruns\n", t.frames, period_us, t.callbacks, t.xruns);
+	printf("  callback mean %.1fus, max %.1fus, p99 < %u%% of the period\n", mean_us, max_us,
+			(p99 + 1) * 100 / (HIST_BINS - 1));
+	printf("  headroom %.1f%% at the worst callback, %.1f%% on average\n",
+			100. * (1. - max_us / period_us), 100. * (1. - mean_us / period_us));
+
+	printf("  %-10s %9s\n", "% period", "callbacks");
+	for(uint32_t i = 0; i < HIST_BINS; i++) {
+		if(t.hist[i]) {
+			if(i == HIST_BINS - 1) {
+				printf("  %-10s %9u\n", ">=100", t.hist[i]);
+			}
+			else {
+				char range[16];
+				snprintf(range, sizeof(range), "%u-%u", i * 5, (i + 1) * 5);
+				printf("  %-10s %9u\n", range, t.hist[i]);
+			}
+		}
+	}
+
+	if(!freerun) {
+		const uint32_t w99 = quantileBin(t.wake, WAKE_BINS, t.callbacks, 0.99);
+		printf("  wake-up lateness max %.1fus, p99 < %uus\n", t.wake_max_ns * 1e-3, 2u << w99);
+		printf("  headroom %.1f%% at the worst callback counting wake-up lateness\n",
+				100. * (1. - t.response_max_ns * 1e-3 / period_us));
+	}
+}
+
+int main(int argc, char **argv) {
+
+	double seconds = 2.;
+	const char *device = NULL;
+	bool freerun = false;
+
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			seconds = atof(argv[++i]);
+		} else if(strcmp(argv[i], "--midi") == 0 && i + 1 < argc) {
+			device = argv[++i];
+		} else if(strcmp(argv[i], "--freerun") == 0) {
+			freerun = true;
+		} else {
+			fprintf(stderr, "usage: %s [-s seconds per period] [--midi <device>] [--freerun]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(!(seconds > 0.)) {
+		fprintf(stderr, "seconds must be positive\n");
+		return 1;
+	}
+
+	const bool locked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+	if(!locked) {
+		fprintf(stderr, "mlockall: %s (continuing unlocked)\n", strerror(errno));
+	}
+
+	OSC_INIT(0, 0);
+
+	int fd = -1;
+	if(device) {
+		fd = open(device, O_RDONLY);
+		if(fd < 0) {
+			fprintf(stderr, "cannot open %s: %s\n", device, strerror(errno));
+			return 1;
+		}
+	}
+	std::thread source = device ? std::thread(readMidi, fd) : std::thread(sequenceMidi);
+
+	std::thread audio(audioThread, seconds, freerun);
+	sched_param sp;
+	sp.sched_priority = RT_PRIORITY;
+	const bool realtime = pthread_setschedparam(audio.native_handle(), SCHED_FIFO, &sp) == 0;
+
+	audio.join();
+	running = false;
+	if(device) {
+		source.detach(); 	// May be blocked in read()
+	}
+	else {
+		source.join();
+	}
+
+	printf("null backend, %s, memory %s, %s scheduling\n", freerun ? "free running" : "paced",
+			locked ? "locked" : "not locked", realtime ? "SCHED_FIFO" : "normal");
+	printf("MIDI %s: %u note ons, %u mapped CCs\n", device ? device : "sequence", midi_in.notes, midi_in.ccs);
+	printf("allocations in the callback: %u\n", callback_allocs.load());
+
+	for(uint32_t p = 0; p < NUM_PERIODS; p++) {
+		printTiming(timings[p], freerun);
+	}
+
+	return callback_allocs ? 1 : 0;
+}
@@ -0,0 +1,302 @@
+/*
+ * File: ubersaw_fuzz.cpp
+ *
+ * Random-sequence fuzzer for the host entry points. Each run
+ * drives one engine instance with a reproducible stream of
+ * operations: parameters of any index and value, note on and
+ * off, queued events, LFO and route settings, envelope times,
+ * stereo width, dither depth, snapshot store, recall and morph,
+ * MIDI CCs, and mono and stereo cycles of 0-256 frames at any
+ * pitch and shape LFO value. Every cycle checks the output for
+ * NaN and Inf and for a peak above the softclip ceiling.
+ *
+ * Build it with -fsanitize=address,undefined (make fuzz) so an
+ * out of bounds access or undefined operation stops the run.
+ * A failure prints the seed and the operation that tripped it.
+ *
+ * Usage: ubersaw_fuzz [--seeds <n>] [--ops <n>] [--seed <first>]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "userosc.h"
+#include "../ubersaw_v1.1.hpp"
+
+// =========================================================
+// Fuzz settings
+// =========================================================
+
+#define MAX_FRAMES 		256 		// Largest cycle
+#define GUARD_FRAMES 	16 			// Canary frames after the largest cycle
+#define CANARY 			0x5A5A5A5A
+#define PEAK_CEILING 	(1.f - SOFTCLIP_C) 	// osc_softclipf(SOFTCLIP_C, 1)
+#define DEFAULT_SEEDS 	8
+#define DEFAULT_OPS 	200000
+
+enum {
+	k_op_param = 0,
+	k_op_note_on,
+	k_op_note_off,
+	k_op_event,
+	k_op_lfo,
+	k_op_route,
+	k_op_envelope,
+	k_op_width,
+	k_op_dither,
+	k_op_store,
+	k_op_recall,
+	k_op_morph,
+	k_op_midi_cc,
+	k_op_cycle_mono,
+	k_op_cycle_stereo,
+	k_num_ops
+};
+
+static const char *op_names[k_num_ops] = {
+	"param", "note_on", "note_off", "event", "lfo", "route", "envelope", "width",
+	"dither", "store", "recall", "morph", "midi_cc", "cycle_mono", "cycle_stereo"
+};
+
+/* // =========================================================
+* Operation stream. Xorshift, so a seed replays the same run.
+*/ // =========================================================
+
+struct Stream {
+	uint32_t 	s;
+
+	explicit Stream(uint32_t seed) :
+		s(seed ? seed : RAND_SEED)
+	{ }
+
+	inline uint32_t next(void) {
+		s ^= s << 13;
+		s ^= s >> 17;
+		s ^= s << 5;
+		return s;
+	}
+
+	inline uint32_t below(uint32_t n) {
+		return next() % n;
+	}
+
+	// Mostly in range values, sometimes anything at all
+
+	inline uint16_t index(void) {
+		return (uint16_t)(below(8) ? below(k_num_ubersaw_params + 2) : next());
+	}
+
+	inline uint16_t value(void) {
+		switch(below(4)) {
+			case 0: return (uint16_t)below(2);
+			case 1: return (uint16_t)below(128);
+			case 2: return (uint16_t)below(1024);
+			default: return (uint16_t)next();
+		}
+	}
+
+	// Any float: ranges around the useful one, zero, NaN and Inf
+
+	inline float real(float range) {
+		switch(below(8)) {
+			case 0: return ZEROF;
+			case 1: return NAN;
+			case 2: return (below(2) ? 1.f : -1.f) * INFINITY;
+			case 3: {
+				const uint32_t bits = next();
+				float x;
+				memcpy(&x, &bits, sizeof(x));
+				return x;
+			}
+			default: return range * ((float)next() / 4294967296.f * 2.f - 1.f);
+		}
+	}
+
+	inline uint32_t frames(void) {
+		return below(4) ? below(OUTPUT_BLOCK + 1) : below(MAX_FRAMES + 1);
+	}
+};
+
+/* // =========================================================
+* Output checks. Mono output is Q31 and may carry TPDF dither
+* of up to 2 LSBs at the dither depth on top of the ceiling.
+*/ // =========================================================
+
+struct Failure {
+	uint32_t 	seed;
+	uint32_t 	op;
+	uint32_t 	kind;
+	uint32_t 	frame;
+	float 		value;
+};
+
+static float ceilingQ31(const UberSaw &u) {
+	const float lsb = u.dither_bits ? ldexpf(1.f, 1 - (int)u.dither_bits) : ldexpf(1.f, -31);
+	return PEAK_CEILING + 2.f * lsb;
+}
+
+static bool checkMono(const UberSaw &u, const int32_t *y, uint32_t frames, Failure &f) {
+	const float ceiling = ceilingQ31(u);
+	for(uint32_t n = 0; n < frames; n++) {
+		const float x = fabsf(q31_to_f32(y[n]));
+		if(x > ceiling) {
+			f.frame = n;
+			f.value = x;
+			return false;
+		}
+	}
+	for(uint32_t n = frames; n < frames + GUARD_FRAMES; n++) {
+		if(y[n] != (int32_t)CANARY) {
+			f.frame = n;
+			f.value = q31_to_f32(y[n]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool checkStereo(const float *y, uint32_t frames, Failure &f) {
+	for(uint32_t n = 0; n < 2 * frames; n++) {
+		if(!(fabsf(y[n]) <= PEAK_CEILING)) { 	// Also catches NaN
+			f.frame = n / 2;
+			f.value = y[n];
+			return false;
+		}
+	}
+	for(uint32_t n = 2 * frames; n < 2 * (frames + GUARD_FRAMES); n++) {
+		uint32_t bits;
+		memcpy(&bits, &y[n], sizeof(bits));
+		if(bits != CANARY) {
+			f.frame = n / 2;
+			f.value = y[n];
+			return false;
+		}
+	}
+	return true;
+}
+
+/* // =========================================================
+* One run: ops operations on a fresh engine. Returns false and
+* fills in f at the first failed check.
+*/ // =========================================================
+
+static bool run(uint32_t seed, uint32_t ops, Failure &f) {
+
+	static UberSaw u;
+	static int32_t mono[MAX_FRAMES + GUARD_FRAMES];
+	static float stereo[2 * (MAX_FRAMES + GUARD_FRAMES)];
+
+	u = UberSaw();
+	u.seed(seed);
+
+	Stream s(seed);
+	user_osc_param_t params;
+	memset(&params, 0, sizeof(params));
+
+	f.seed = seed;
+
+	for(uint32_t i = 0; i < ops; i++) {
+
+		const uint32_t op = s.below(k_num_ops);
+		f.op = i;
+		f.kind = op;
+
+		switch(op) {
+			case k_op_param:
+				ubersaw_param(u, s.index(), s.value());
+				break;
+			case k_op_note_on:
+				ubersaw_note_on(u);
+				break;
+			case k_op_note_off:
+				ubersaw_note_off(u);
+				break;
+			case k_op_event:
+				u.events.push(u.state.clock + s.below(2 * MAX_FRAMES) - MAX_FRAMES / 2, s.index(), s.value());
+				break;
+			case k_op_lfo:
+				u.setLfo(s.below(NUM_LFO + 1), s.below(k_num_lfo_waves + 1), s.real(2.f * LFO_MAX_HZ));
+				break;
+			case k_op_route:
+				u.setRoute(s.below(NUM_LFO + 1), s.below(k_num_mod_dest + 1), s.real(2.f));
+				break;
+			case k_op_envelope:
+				ubersaw_set_envelope(u, s.real(1000.f), s.real(10000.f));
+				break;
+			case k_op_width:
+				u.setWidth(s.real(2.f));
+				break;
+			case k_op_dither:
+				ubersaw_set_dither(u, s.below(4) ? 0 : s.below(40));
+				break;
+			case k_op_store:
+				ubersaw_store(u, s.below(NUM_SNAPSHOTS + 2));
+				break;
+			case k_op_recall:
+				ubersaw_recall(u, s.below(NUM_SNAPSHOTS + 2));
+				break;
+			case k_op_morph:
+				ubersaw_morph(u, s.below(NUM_SNAPSHOTS + 2), s.below(NUM_SNAPSHOTS + 2), s.real(1.5f));
+				break;
+			case k_op_midi_cc:
+				ubersaw_midi_cc(u, (uint8_t)s.next(), (uint8_t)s.next());
+				break;
+			case k_op_cycle_mono:
+			case k_op_cycle_stereo: {
+				const uint32_t frames = s.frames();
+				params.pitch = (uint16_t)s.next();
+				params.shape_lfo = (int32_t)s.next();
+				if(op == k_op_cycle_mono) {
+					memset(mono, CANARY & 0xFF, sizeof(mono));
+					ubersaw_cycle(u, &params, mono, frames);
+					if(!checkMono(u, mono, frames, f)) {
+						return false;
+					}
+				}
+				else {
+					memset(stereo, CANARY & 0xFF, sizeof(stereo));
+					ubersaw_cycle_stereo(u, &params, stereo, stereo + 1, 2, frames);
+					if(!checkStereo(stereo, frames, f)) {
+						return false;
+					}
+				}
+			} break;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv) {
+
+	uint32_t seeds = DEFAULT_SEEDS;
+	uint32_t ops = DEFAULT_OPS;
+	uint32_t first = 1;
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "--seeds") == 0 && i + 1 < argc) {
+			seeds = (uint32_t)strtoul(argv[++i], NULL, 0);
+		} else if(strcmp(argv[i], "--ops") == 0 && i + 1 < argc) {
+			ops = (uint32_t)strtoul(argv[++i], NULL, 0);
+		} else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			first = (uint32_t)strtoul(argv[++i], NULL, 0);
+		} else {
+			fprintf(stderr, "usage: %s [--seeds <n>] [--ops <n>] [--seed <first>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	for(uint32_t i = 0; i < seeds; i++) {
+		Failure f;
+		if(!run(first + i, ops, f)) {
+			fprintf(stderr, "FAIL seed %u op %u (%s): frame %u value %g\n",
+					f.seed, f.op, op_names[f.kind], f.frame, (double)f.value);
+			return 1;
+		}
+		printf("seed %u: %u ops ok\n", first + i, ops);
+	}
+
+	return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * File: ubersaw_preset.cpp
+ *
+ * Memory mapped preset banks for host builds (POSIX).
+ *
+ */
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "userosc.h"
+#include "ubersaw_preset.hpp"
+
+// =========================================================
+// The parameter block must match UberSaw::Params exactly
+// =========================================================
+
+#define SAME_FIELD(f) \
+	static_assert(offsetof(PresetParams, f) == offsetof(UberSaw::Params, f), "PresetParams." #f)
+
+SAME_FIELD(mix_A);
+SAME_FIELD(mix_B);
+SAME_FIELD(ringmix);
+SAME_FIELD(detune);
+SAME_FIELD(shape);
+SAME_FIELD(shiftshape);
+SAME_FIELD(fm);
+SAME_FIELD(sync);
+SAME_FIELD(chord);
+SAME_FIELD(phase);
+
+static_assert(sizeof(PresetParams) == sizeof(UberSaw::Params), "PresetParams size");
+static_assert(sizeof(PresetRecord) == 96, "PresetRecord size");
+static_assert(sizeof(PresetHeader) == 64, "PresetHeader size");
+
+// =========================================================
+// FNV-1a, 64 bit
+// =========================================================
+
+#define FNV_OFFSET 	0xCBF29CE484222325ull
+#define FNV_PRIME 	0x00000100000001B3ull
+
+static uint64_t checksum(const uint8_t *p, uint64_t size) {
+	uint64_t h = FNV_OFFSET;
+	for(uint64_t i = 0; i < size; i++) {
+		h ^= p[i];
+		h *= FNV_PRIME;
+	}
+	return h;
+}
+
+// =========================================================
+// Banks are little-endian, and the records are used in place
+// =========================================================
+
+static inline bool littleEndian(void) {
+	const uint16_t x = 1;
+	return *(const uint8_t *)&x == 1;
+}
+
+static inline bool inRange(const float x, const float lo, const float hi) {
+	return x >= lo && x <= hi; 	// False for NaN
+}
+
+/* // =========================================================
+* A record is usable if every parameter is in the range
+* setParam() produces and the interval is a sane ratio.
+*/ // =========================================================
+
+static bool validRecord(const PresetRecord &r) {
+
+	const PresetParams &p = r.params;
+
+	return memchr(r.name, 0, PRESET_NAME) != NULL
+			&& inRange(p.mix_A, ZEROF, 1.f)
+			&& inRange(p.mix_B, ZEROF, 1.f)
+			&& inRange(p.ringmix, ZEROF, 1.f)
+			&& inRange(p.detune, ZEROF, 1.f)
+			&& inRange(p.shape, ZEROF, 1.f)
+			&& inRange(p.shiftshape, ZEROF, 1.f)
+			&& inRange(p.fm, ZEROF, 1.f)
+			&& p.sync <= 1
+			&& p.chord < NUM_CHORDS
+			&& p.phase < k_num_phase_policies
+			&& inRange(r.interval.ratio, 0.25f, 4.f)
+			&& inRange(r.interval.recip, 0.25f, 4.f);
+}
+
+PresetBank::PresetBank(void) :
+	base(NULL),
+	records(NULL),
+	mapped(0),
+	stride(0),
+	count(0),
+	fd(-1)
+{ }
+
+PresetBank::~PresetBank(void) {
+	close();
+}
+
+/* // =========================================================
+* Map a bank read-only and check the header, the checksum and
+* every record, so apply() can copy without checking again.
+*/ // =========================================================
+
+bool PresetBank::open(const char *path) {
+
+	close();
+
+	if(!littleEndian()) {
+		return false;
+	}
+
+	fd = ::open(path, O_RDONLY);
+	if(fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(PresetHeader)) {
+		close();
+		return false;
+	}
+
+	mapped = (uint64_t)st.st_size;
+	void *map = mmap(NULL, mapped, PROT_READ, MAP_SHARED, fd, 0);
+	if(map == MAP_FAILED) {
+		mapped = 0;
+		close();
+		return false;
+	}
+	base = (const uint8_t *)map;
+
+	const PresetHeader &h = *(const PresetHeader *)base;
+	const uint64_t bytes = (uint64_t)h.count * h.record_size;
+
+	if(h.magic != PRESET_MAGIC || h.layout != PRESET_LAYOUT
+			|| h.record_size < sizeof(PresetRecord) || (h.record_size & 3) != 0
+			|| h.count > PRESET_MAX || sizeof(PresetHeader) + bytes > mapped
+			|| checksum(base + sizeof(PresetHeader), bytes) != h.checksum) {
+		close();
+		return false;
+	}
+
+	records = base + sizeof(PresetHeader);
+	stride = h.record_size;
+	count = h.count;
+
+	for(uint32_t i = 0; i < count; i++) {
+		if(!validRecord(*record(i))) {
+			close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void PresetBank::close(void) {
+	if(base) {
+		munmap((void *)base, mapped);
+	}
+	if(fd >= 0) {
+		::close(fd);
+	}
+	base = NULL;
+	records = NULL;
+	mapped = 0;
+	stride = 0;
+	count = 0;
+	fd = -1;
+}
+
+const char *PresetBank::name(uint32_t i) const {
+	return (i < count) ? record(i)->name : NULL;
+}
+
+/* // =========================================================
+* Apply a preset: one block copy into Params and the stored
+* interval. The next block ramps to the new sound, as for any
+* other parameter change.
+*/ // =========================================================
+
+bool PresetBank::apply(UberSaw &u, uint32_t i) const {
+
+	if(i >= count) {
+		return false;
+	}
+
+	const PresetRecord *r = record(i);
+	memcpy((void *)&u.params, &r->params, sizeof(u.params));
+	u.state.interval = r->interval;
+	return true;
+}
+
+void PresetBank::capture(const UberSaw &u, const char *name, PresetRecord &r) {
+	memset(&r, 0, sizeof(r));
+	strncpy(r.name, name, PRESET_NAME - 1);
+	memcpy(&r.params, &u.params, sizeof(r.params));
+	r.interval = u.state.interval;
+}
+
+bool PresetBank::write(const char *path, const PresetRecord *records, uint32_t count) {
+
+	if(!littleEndian() || count > PRESET_MAX) {
+		return false;
+	}
+
+	PresetHeader h;
+	memset(&h, 0, sizeof(h));
+	h.magic = PRESET_MAGIC;
+	h.layout = PRESET_LAYOUT;
+	h.record_size = sizeof(PresetRecord);
+	h.count = count;
+	h.engine = UBERSAW_ENGINE_VERSION;
+	h.checksum = checksum((const uint8_t *)records, (uint64_t)count * sizeof(PresetRecord));
+
+	FILE *f = fopen(path, "wb");
+	if(f == NULL) {
+		return false;
+	}
+
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+	if(ok && count) {
+		ok = fwrite(records, sizeof(PresetRecord), count, f) == count;
+	}
+
+	return (fclose(f) == 0) && ok;
+}
@@ -0,0 +1,111 @@
+/*
+ * File: ubersaw_preset.hpp
+ *
+ * Binary preset banks for host builds. A bank is a header and
+ * a packed array of fixed size records, little-endian and
+ * checksummed. Each record holds the engine parameters in the
+ * UberSaw::Params layout and the chord interval derived from
+ * them. A bank is validated once when it is mapped, so applying
+ * a preset is a bounds check and a block copy, whatever the
+ * size of the bank.
+ *
+ */
+
+#pragma once
+
+#include "../ubersaw_v1.1.hpp"
+
+// =========================================================
+// Bank file layout
+// =========================================================
+
+#define PRESET_MAGIC 		0x55535042u 	// "USPB"
+#define PRESET_LAYOUT 		1 				// Bump when existing fields change
+#define PRESET_NAME 		32 				// Name bytes, NUL padded
+#define PRESET_MAX 			0x100000 		// Presets per bank
+
+/* // =========================================================
+* Parameter block: the same fields, in the same order and
+* size, as UberSaw::Params, so a preset copies straight in.
+*/ // =========================================================
+
+struct PresetParams {
+	float   	mix_A;
+	float   	mix_B;
+	float   	ringmix;
+	float 		detune;
+	float   	shape;
+	float   	shiftshape;
+	float 		fm;
+	uint32_t 	sync;
+	uint32_t 	chord;
+	uint32_t 	phase;
+};
+
+// =========================================================
+// One preset (96 bytes)
+// =========================================================
+
+struct PresetRecord {
+	char 			name[PRESET_NAME];
+	PresetParams 	params;
+	Interval 		interval;		// Derived from params.chord (or a morph)
+	uint32_t 		reserved[4];	// Zero
+};
+
+/* // =========================================================
+* Bank header (64 bytes). record_size lets a reader step over
+* fields appended by a later layout.
+*/ // =========================================================
+
+struct PresetHeader {
+	uint32_t 	magic;
+	uint16_t 	layout;
+	uint16_t 	record_size;
+	uint32_t 	count;
+	uint32_t 	engine;			// UBERSAW_ENGINE_VERSION of the writer
+	uint64_t 	checksum;		// FNV-1a of the records
+	uint32_t 	reserved[10];	// Zero
+};
+
+/* // =========================================================
+* A read-only mapped bank. Records stay valid until close().
+*/ // =========================================================
+
+class PresetBank {
+public:
+	PresetBank(void);
+	~PresetBank(void);
+
+	// Map a bank and validate every record, false if it is not a usable bank
+	bool open(const char *path);
+	void close(void);
+
+	uint32_t size(void) const {
+		return count;
+	}
+
+	// Name of preset i, or NULL
+	const char *name(uint32_t i) const;
+
+	// Switch u to preset i, false if out of range
+	bool apply(UberSaw &u, uint32_t i) const;
+
+	// Fill a record from u's current sound
+	static void capture(const UberSaw &u, const char *name, PresetRecord &r);
+
+	// Write count records as a bank
+	static bool write(const char *path, const PresetRecord *records, uint32_t count);
+
+private:
+	const PresetRecord *record(uint32_t i) const {
+		return (const PresetRecord *)(records + (uint64_t)i * stride);
+	}
+
+	const uint8_t 	*base;
+	const uint8_t 	*records;
+	uint64_t 		mapped;
+	uint32_t 		stride;
+	uint32_t 		count;
+	int 			fd;
+};
@@ -0,0 +1,346 @@
+/*
+ * File: ubersaw_preset_bench.cpp
+ *
+ * Checks and load-time benchmark for preset banks. It first
+ * checks that a preset applied from a saved bank renders
+ * bit-identically to setting the same parameters directly,
+ * and that banks with a bad checksum, a truncated file, a bad
+ * header or an out of range record are rejected. It then
+ * writes and maps banks of 16 to 262144 random presets and
+ * prints the bank size, the open() time and the apply() time
+ * of each.
+ *
+ * Usage: ubersaw_preset_bench [-o dir]
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "userosc.h"
+#include "ubersaw_preset.hpp"
+
+// =========================================================
+// Settings
+// =========================================================
+
+#define CHECK_PRESETS 	64 			// Presets in the round trip bank
+#define CHECK_BLOCKS 	64 			// Blocks rendered per compared preset
+#define BLOCK_FRAMES 	64
+#define OPEN_RUNS 		3 			// Timed opens per bank, the fastest is kept
+#define APPLY_COUNT 	(1 << 20) 	// Timed applies per bank
+#define APPLY_RUNS 		3 			// Timed apply runs, the fastest is kept
+
+static const uint32_t bank_sizes[] = { 16, 1024, 16384, 262144 };
+
+#define NUM_BANK_SIZES 	(sizeof(bank_sizes) / sizeof(bank_sizes[0]))
+
+static inline double now(void) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// =========================================================
+// Random parameter values, in the ranges setParam() takes
+// =========================================================
+
+struct Values {
+	uint16_t 	v[k_num_ubersaw_params];
+};
+
+static uint32_t rng = RAND_SEED;
+
+static inline uint32_t next(void) {
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static void randomValues(Values &x) {
+	x.v[k_user_osc_param_id1] = (uint16_t)(next() % 101);
+	x.v[k_user_osc_param_id2] = (uint16_t)(next() % 101);
+	x.v[k_user_osc_param_id3] = (uint16_t)(next() % 101);
+	x.v[k_user_osc_param_id4] = (uint16_t)(next() % 101);
+	x.v[k_user_osc_param_id5] = (uint16_t)(1 + next() % NUM_CHORDS);
+	x.v[k_user_osc_param_id6] = (uint16_t)(1 + next() % k_num_phase_policies);
+	x.v[k_user_osc_param_shape] = (uint16_t)(next() % 1024);
+	x.v[k_user_osc_param_shiftshape] = (uint16_t)(next() % 1024);
+	x.v[k_ubersaw_param_fm] = (uint16_t)(next() % 101);
+	x.v[k_ubersaw_param_sync] = (uint16_t)(next() % 2);
+}
+
+static void setValues(UberSaw &u, const Values &x) {
+	for(uint16_t i = 0; i < k_num_ubersaw_params; i++) {
+		ubersaw_param(u, i, x.v[i]);
+	}
+}
+
+// Random presets, captured from a scratch copy of clean
+
+static void randomRecords(const UberSaw &clean, PresetRecord *records, uint32_t count) {
+	static UberSaw u;
+	for(uint32_t i = 0; i < count; i++) {
+		Values x;
+		randomValues(x);
+		u = clean;
+		setValues(u, x);
+		char name[PRESET_NAME];
+		snprintf(name, sizeof(name), "preset %u", i);
+		PresetBank::capture(u, name, records[i]);
+	}
+}
+
+/* // =========================================================
+* Round trip: render each preset applied from the bank and
+* the same parameters set directly, from the same engine
+* state, and compare the output bit for bit.
+*/ // =========================================================
+
+static bool checkRoundTrip(const UberSaw &clean, const char *path) {
+
+	static PresetRecord records[CHECK_PRESETS];
+	static Values values[CHECK_PRESETS];
+	static UberSaw a, b;
+
+	for(uint32_t i = 0; i < CHECK_PRESETS; i++) {
+		randomValues(values[i]);
+		a = clean;
+		setValues(a, values[i]);
+		char name[PRESET_NAME];
+		snprintf(name, sizeof(name), "check %u", i);
+		PresetBank::capture(a, name, records[i]);
+	}
+
+	PresetBank bank;
+	if(!PresetBank::write(path, records, CHECK_PRESETS) || !bank.open(path)
+			|| bank.size() != CHECK_PRESETS) {
+		printf("round trip: cannot write and open %s\n", path);
+		return false;
+	}
+
+	user_osc_param_t params;
+	memset(&params, 0, sizeof(params));
+	int32_t ya[BLOCK_FRAMES], yb[BLOCK_FRAMES];
+
+	for(uint32_t i = 0; i < CHECK_PRESETS; i++) {
+
+		a = clean;
+		b = clean;
+		bank.apply(a, i);
+		setValues(b, values[i]);
+
+		if(strcmp(bank.name(i), records[i].name) != 0) {
+			printf("round trip: preset %u name differs\n", i);
+			return false;
+		}
+
+		params.pitch = (uint16_t)((36 + i) << 8);
+		ubersaw_note_on(a);
+		ubersaw_note_on(b);
+		for(uint32_t n = 0; n < CHECK_BLOCKS; n++) {
+			ubersaw_cycle(a, &params, ya, BLOCK_FRAMES);
+			ubersaw_cycle(b, &params, yb, BLOCK_FRAMES);
+			if(memcmp(ya, yb, sizeof(ya)) != 0) {
+				printf("round trip: preset %u differs in block %u\n", i, n);
+				return false;
+			}
+		}
+	}
+
+	printf("round trip: %u presets render bit-identically to direct parameters\n", CHECK_PRESETS);
+	return true;
+}
+
+/* // =========================================================
+* Corruption: each damaged bank must fail to open.
+*/ // =========================================================
+
+static bool writeRaw(const char *path, const void *data, size_t size) {
+	FILE *f = fopen(path, "wb");
+	if(f == NULL) {
+		return false;
+	}
+	const bool ok = fwrite(data, 1, size, f) == size;
+	return (fclose(f) == 0) && ok;
+}
+
+static bool rejected(const char *what, const char *path) {
+	PresetBank bank;
+	const bool ok = !bank.open(path);
+	printf("  %-28s %s\n", what, ok ? "rejected" : "ACCEPTED");
+	return ok;
+}
+
+static bool checkCorruption(const UberSaw &clean, const char *path) {
+
+	static PresetRecord records[CHECK_PRESETS];
+	static uint8_t file[sizeof(PresetHeader) + sizeof(records)];
+	randomRecords(clean, records, CHECK_PRESETS);
+
+	// A good bank, read back as bytes
+
+	PresetBank bank;
+	FILE *f = NULL;
+	if(!PresetBank::write(path, records, CHECK_PRESETS) || !bank.open(path)
+			|| (f = fopen(path, "rb")) == NULL || fread(file, 1, sizeof(file), f) != sizeof(file)) {
+		printf("corruption: cannot write and read back %s\n", path);
+		if(f) {
+			fclose(f);
+		}
+		return false;
+	}
+	fclose(f);
+	bank.close();
+
+	static uint8_t bad[sizeof(file)];
+	PresetHeader &h = *(PresetHeader *)bad;
+	PresetRecord *r = (PresetRecord *)(bad + sizeof(PresetHeader));
+	bool ok = true;
+
+	printf("corruption:\n");
+
+	memcpy(bad, file, sizeof(file));
+	bad[sizeof(PresetHeader) + 5 * sizeof(PresetRecord) + 40] ^= 0x01;
+	ok &= writeRaw(path, bad, sizeof(bad)) && rejected("flipped record bit", path);
+
+	memcpy(bad, file, sizeof(file));
+	h.checksum ^= 1;
+	ok &= writeRaw(path, bad, sizeof(bad)) && rejected("bad checksum", path);
+
+	ok &= writeRaw(path, file, sizeof(file) - 1) && rejected("truncated by one byte", path);
+	ok &= writeRaw(path, file, sizeof(file) / 2) && rejected("truncated to half", path);
+	ok &= writeRaw(path, file, sizeof(PresetHeader) - 1) && rejected("truncated header", path);
+
+	memcpy(bad, file, sizeof(file));
+	h.magic ^= 0xFF;
+	ok &= writeRaw(path, bad, sizeof(bad)) && rejected("bad magic", path);
+
+	memcpy(bad, file, sizeof(file));
+	h.layout = PRESET_LAYOUT + 1;
+	ok &= writeRaw(path, bad, sizeof(bad)) && rejected("unknown layout", path);
+
+	memcpy(bad, file, sizeof(file));
+	h.count = CHECK_PRESETS + 1;
+	ok &= writeRaw(path, bad, sizeof(bad)) && rejected("count past the end", path);
+
+	// Out of range records, with a valid checksum
+
+	memcpy(bad, file, sizeof(file));
+	r[7].params.chord = NUM_CHORDS;
+	ok &= PresetBank::write(path, r, CHECK_PRESETS) && rejected("out of range chord", path);
+
+	memcpy(bad, file, sizeof(file));
+	r[3].params.phase = k_num_phase_policies;
+	ok &= PresetBank::write(path, r, CHECK_PRESETS) && rejected("out of range phase policy", path);
+
+	memcpy(bad, file, sizeof(file));
+	r[9].params.detune = NAN;
+	ok &= PresetBank::write(path, r, CHECK_PRESETS) && rejected("NaN detune", path);
+
+	memcpy(bad, file, sizeof(file));
+	memset(r[2].name, 'x', PRESET_NAME);
+	ok &= PresetBank::write(path, r, CHECK_PRESETS) && rejected("unterminated name", path);
+
+	return ok;
+}
+
+/* // =========================================================
+* Load time: write a bank of count random presets, then time
+* open() (which validates the whole bank) and apply() at
+* random indices.
+*/ // =========================================================
+
+static bool benchBank(const UberSaw &clean, const char *path, uint32_t count) {
+
+	PresetRecord *records = (PresetRecord *)malloc((size_t)count * sizeof(PresetRecord));
+	uint32_t *order = (uint32_t *)malloc(APPLY_COUNT * sizeof(uint32_t));
+	if(!records || !order) {
+		free(records);
+		free(order);
+		return false;
+	}
+
+	randomRecords(clean, records, count);
+	const bool written = PresetBank::write(path, records, count);
+	free(records);
+	if(!written) {
+		free(order);
+		return false;
+	}
+
+	PresetBank bank;
+	double open_s = 1e9;
+	for(int run = 0; run < OPEN_RUNS; run++) {
+		bank.close();
+		const double t0 = now();
+		const bool ok = bank.open(path);
+		const double t = now() - t0;
+		if(!ok) {
+			free(order);
+			return false;
+		}
+		open_s = (t < open_s) ? t : open_s;
+	}
+
+	for(uint32_t i = 0; i < APPLY_COUNT; i++) {
+		order[i] = next() % count;
+	}
+
+	static UberSaw u;
+	u = clean;
+	double apply_s = 1e9;
+	volatile float sink = ZEROF; 	// Keeps the applies
+	for(int run = 0; run < APPLY_RUNS; run++) {
+		const double t0 = now();
+		for(uint32_t i = 0; i < APPLY_COUNT; i++) {
+			bank.apply(u, order[i]);
+			sink += u.params.detune;
+		}
+		const double t = now() - t0;
+		apply_s = (t < apply_s) ? t : apply_s;
+	}
+	free(order);
+
+	const double kb = (sizeof(PresetHeader) + (double)count * sizeof(PresetRecord)) / 1024.;
+	printf("%-9u %10.1fKB %10.3fms %8.1fns\n", count, kb, open_s * 1e3, apply_s * 1e9 / APPLY_COUNT);
+	return true;
+}
+
+int main(int argc, char **argv) {
+
+	const char *dir = ".";
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			dir = argv[++i];
+		} else {
+			fprintf(stderr, "usage: %s [-o dir]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	char path[512];
+	snprintf(path, sizeof(path), "%s/presets.bank", dir);
+
+	// One clean engine, built before anything else, copied for every use
+
+	static UberSaw clean;
+
+	bool ok = checkRoundTrip(clean, path);
+	ok &= checkCorruption(clean, path);
+
+	printf("\n%-9s %12s %12s %10s\n", "presets", "bank", "open", "apply");
+	for(uint32_t i = 0; i < NUM_BANK_SIZES && ok; i++) {
+		if(!benchBank(clean, path, bank_sizes[i])) {
+			printf("cannot write and open a bank of %u presets\n", bank_sizes[i]);
+			ok = false;
+		}
+	}
+
+	unlink(path);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+/*
+ * File: ubersaw_profile.cpp
+ *
+ * Host training and cycle driver for the oscillator unit. It
+ * plays a note sweep over a few detune, mix, drift and phase
+ * settings through the OSC_* hooks, exactly as the synth calls
+ * them, and prints the cycles per sample of each setting.
+ *
+ * It is built like the unit (without UBERSAW_HOST, with the
+ * PLATFORM defines), so a -fprofile-generate build of it
+ * records a profile whose control flow matches the oscillator
+ * object, and "make compare" times the baseline and modern
+ * flag sets on the same workload.
+ *
+ * Usage: ubersaw_profile
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "userosc.h"
+#include "../ubersaw_v1.1.hpp"
+
+// =========================================================
+// Workload
+// =========================================================
+
+#define BLOCK_FRAMES 	64 			// Largest OSC_CYCLE block
+#define NOTE_BLOCKS 	375 		// Held blocks per note (0.5s)
+#define RELEASE_BLOCKS 	75 			// Blocks after note off (0.1s)
+
+struct Setting {
+	const char 	*name;
+	uint16_t 	mix; 		// Parameters 1 and 2, secondary mixes [0-100]
+	uint16_t 	ring; 		// Parameter 3, ring mix [0-100]
+	uint16_t 	detune; 	// Parameter 4 [0-100]
+	uint16_t 	phase; 		// Parameter 6, phase policy [1-3]
+	uint16_t 	shape; 		// Supersaw mix (A knob) [0-1023]
+	uint16_t 	drift; 		// Phase drift (B knob) [0-1023]
+};
+
+static const Setting settings[] = {
+	{ "tight", 0, 0, 0, 1, 0, 0 },
+	{ "supersaw", 0, 0, 50, 1, 512, 256 },
+	{ "wide", 0, 0, 100, 3, 1023, 1023 },
+	{ "chord", 50, 25, 50, 2, 512, 256 }
+};
+
+static const uint8_t notes[] = { 24, 36, 48, 60, 72, 84, 96, 108 };
+
+#define NUM_SETTINGS 	(sizeof(settings) / sizeof(settings[0]))
+#define NUM_NOTES 		(sizeof(notes) / sizeof(notes[0]))
+
+/* // =========================================================
+* Play every note of the sweep with one setting. Returns the
+* cycles per sample spent in OSC_CYCLE.
+*/ // =========================================================
+
+static double play(const Setting &s) {
+
+	OSC_PARAM(k_user_osc_param_id1, s.mix);
+	OSC_PARAM(k_user_osc_param_id2, s.mix);
+	OSC_PARAM(k_user_osc_param_id3, s.ring);
+	OSC_PARAM(k_user_osc_param_id4, s.detune);
+	OSC_PARAM(k_user_osc_param_id6, s.phase);
+	OSC_PARAM(k_user_osc_param_shape, s.shape);
+	OSC_PARAM(k_user_osc_param_shiftshape, s.drift);
+
+	user_osc_param_t params;
+	memset(&params, 0, sizeof(params));
+
+	int32_t buf[BLOCK_FRAMES];
+	uint64_t total = 0;
+	uint32_t frames = 0;
+
+	for(uint32_t n = 0; n < NUM_NOTES; n++) {
+		params.pitch = (uint16_t)(notes[n] << 8);
+		OSC_NOTEON(&params);
+		for(uint32_t b = 0; b < NOTE_BLOCKS + RELEASE_BLOCKS; b++) {
+			if(b == NOTE_BLOCKS) {
+				OSC_NOTEOFF(&params);
+			}
+			params.shape_lfo = (int32_t)((b & 63) << 25);
+			const uint32_t start = cyclesNow();
+			OSC_CYCLE(&params, buf, BLOCK_FRAMES);
+			total += cyclesNow() - start;
+			frames += BLOCK_FRAMES;
+		}
+	}
+
+	return (double)total / frames;
+}
+
+int main(void) {
+
+	OSC_INIT(0, 0);
+	cyclesInit();
+
+	double sum = 0.;
+	printf("%-10s %9s\n", "setting", "cyc/smp");
+	for(uint32_t i = 0; i < NUM_SETTINGS; i++) {
+		const double cycles = play(settings[i]);
+		sum += cycles;
+		printf("%-10s %9.1f\n", settings[i].name, cycles);
+	}
+	printf("%-10s %9.1f\n", "mean", sum / NUM_SETTINGS);
+
+	return 0;
+}
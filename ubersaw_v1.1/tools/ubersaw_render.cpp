@@ -0,0 +1,652 @@
+/*
+ * File: ubersaw_render.cpp
+ *
+ * Batch renderer for host builds (C++20). Renders a set of
+ * UberSaw instances to 16 bit stereo WAV files through a
+ * cooperative pipeline: each job is three coroutines (render,
+ * encode, write) linked by bounded channels and run on a small
+ * thread pool. Every job yields after each block, so many
+ * renders interleave with file I/O without a thread per job,
+ * and a full channel suspends the stage that feeds it.
+ *
+ * Usage: ubersaw_render [-j threads] [-n jobs] [-s seconds]
+ *                       [-d depth] [-o dir] [--bench]
+ *
+ * --bench renders the same jobs with a plain sequential loop
+ * first, checks both runs wrote the same audio and prints the
+ * throughput of each.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "userosc.h"
+#include "../ubersaw_v1.1.hpp"
+
+// =========================================================
+// Settings
+// =========================================================
+
+#define SAMPLERATE 		48000
+#define ENGINE_FRAMES 	64 			// Frames per ubersaw_cycle_stereo call
+#define BLOCK_FRAMES 	1024 		// Frames per pipeline block (one yield)
+#define WAV_HEADER 		44
+
+/* // =========================================================
+* Thread pool running ready coroutines in FIFO order. live
+* counts the coroutines spawned and not yet finished.
+*/ // =========================================================
+
+class Executor {
+public:
+	explicit Executor(uint32_t threads) :
+		live(0),
+		stop(false)
+	{
+		for(uint32_t i = 0; i < threads; i++) {
+			workers.emplace_back([this] { run(); });
+		}
+	}
+
+	~Executor(void) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stop = true;
+		}
+		ready.notify_all();
+		for(std::thread &t : workers) {
+			t.join();
+		}
+	}
+
+	void schedule(std::coroutine_handle<> h) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			queue.push_back(h);
+		}
+		ready.notify_one();
+	}
+
+	void started(void) {
+		std::lock_guard<std::mutex> guard(lock);
+		live++;
+	}
+
+	void finished(void) {
+		std::lock_guard<std::mutex> guard(lock);
+		if(--live == 0) {
+			idle.notify_all();
+		}
+	}
+
+	// Block until every spawned coroutine has finished
+
+	void wait(void) {
+		std::unique_lock<std::mutex> guard(lock);
+		idle.wait(guard, [this] { return live == 0; });
+	}
+
+	// Awaitable: requeue the caller behind the other ready coroutines
+
+	struct Yield {
+		Executor &ex;
+		bool await_ready(void) const noexcept {
+			return false;
+		}
+		void await_suspend(std::coroutine_handle<> h) const {
+			ex.schedule(h);
+		}
+		void await_resume(void) const noexcept { }
+	};
+
+	Yield yield(void) {
+		return Yield{ *this };
+	}
+
+private:
+	void run(void) {
+		for(;;) {
+			std::coroutine_handle<> h;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				ready.wait(guard, [this] { return stop || !queue.empty(); });
+				if(queue.empty()) {
+					return;
+				}
+				h = queue.front();
+				queue.pop_front();
+			}
+			h.resume();
+		}
+	}
+
+	std::mutex 							lock;
+	std::condition_variable 			ready;
+	std::condition_variable 			idle;
+	std::deque<std::coroutine_handle<>> queue;
+	std::vector<std::thread> 			workers;
+	uint32_t 							live;
+	bool 								stop;
+};
+
+/* // =========================================================
+* Fire and forget coroutine. The first parameter of every Task
+* coroutine is its Executor: it starts suspended until spawned,
+* and frees itself and tells the executor when it finishes.
+*/ // =========================================================
+
+struct Task {
+	struct promise_type {
+		Executor *ex;
+
+		template <class... Args>
+		promise_type(Executor &e, Args &...) :
+			ex(&e)
+		{
+			e.started();
+		}
+
+		Task get_return_object(void) {
+			return Task{ std::coroutine_handle<promise_type>::from_promise(*this) };
+		}
+
+		std::suspend_always initial_suspend(void) noexcept {
+			return {};
+		}
+
+		struct Final {
+			bool await_ready(void) const noexcept {
+				return false;
+			}
+			void await_suspend(std::coroutine_handle<promise_type> h) const noexcept {
+				Executor *e = h.promise().ex;
+				h.destroy();
+				e->finished();
+			}
+			void await_resume(void) const noexcept { }
+		};
+
+		Final final_suspend(void) noexcept {
+			return {};
+		}
+
+		void return_void(void) { }
+
+		void unhandled_exception(void) {
+			abort();
+		}
+	};
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+static void spawn(Executor &ex, Task t) {
+	ex.schedule(t.handle);
+}
+
+/* // =========================================================
+* Bounded channel of pointers between two coroutines. send()
+* suspends while the channel is full and receive() while it
+* is empty; the other side reschedules the waiter on the
+* executor. A NULL item marks the end of the stream.
+*/ // =========================================================
+
+template <class T>
+class Channel {
+public:
+	Channel(Executor &e, uint32_t capacity) :
+		ex(e),
+		cap(capacity ? capacity : 1)
+	{ }
+
+	struct Send {
+		Channel &c;
+		T *item;
+		bool await_ready(void) const noexcept {
+			return false;
+		}
+		bool await_suspend(std::coroutine_handle<> h) {
+			return c.push(h, item);
+		}
+		void await_resume(void) const noexcept { }
+	};
+
+	struct Receive {
+		Channel &c;
+		T *item;
+		bool await_ready(void) const noexcept {
+			return false;
+		}
+		bool await_suspend(std::coroutine_handle<> h) {
+			return c.pop(h, &item);
+		}
+		T *await_resume(void) const noexcept {
+			return item;
+		}
+	};
+
+	Send send(T *item) {
+		return Send{ *this, item };
+	}
+
+	Receive receive(void) {
+		return Receive{ *this, NULL };
+	}
+
+private:
+	struct Waiter {
+		std::coroutine_handle<> h;
+		T *item; 		// Pending item (sender)
+		T **slot; 		// Where to deliver (receiver)
+	};
+
+	// True if the sender has to wait for space
+
+	bool push(std::coroutine_handle<> h, T *item) {
+		std::unique_lock<std::mutex> guard(lock);
+		if(!receivers.empty()) {
+			const Waiter w = receivers.front();
+			receivers.pop_front();
+			guard.unlock();
+			*w.slot = item;
+			ex.schedule(w.h);
+			return false;
+		}
+		if(items.size() < cap) {
+			items.push_back(item);
+			return false;
+		}
+		senders.push_back(Waiter{ h, item, NULL });
+		return true;
+	}
+
+	// True if the receiver has to wait for an item
+
+	bool pop(std::coroutine_handle<> h, T **slot) {
+		std::unique_lock<std::mutex> guard(lock);
+		if(!items.empty()) {
+			*slot = items.front();
+			items.pop_front();
+			if(!senders.empty()) {
+				const Waiter w = senders.front();
+				senders.pop_front();
+				items.push_back(w.item);
+				guard.unlock();
+				ex.schedule(w.h);
+			}
+			return false;
+		}
+		receivers.push_back(Waiter{ h, NULL, slot });
+		return true;
+	}
+
+	Executor 			&ex;
+	const uint32_t 		cap;
+	std::mutex 			lock;
+	std::deque<T *> 	items;
+	std::deque<Waiter> 	senders;
+	std::deque<Waiter> 	receivers;
+};
+
+// =========================================================
+// One block of audio on its way through the pipeline
+// =========================================================
+
+struct Block {
+	float 		pcm[BLOCK_FRAMES * 2];		// Interleaved float from the engine
+	int16_t 	wav[BLOCK_FRAMES * 2];		// Interleaved 16 bit PCM
+	uint32_t 	frames;
+};
+
+/* // =========================================================
+* A render job: one engine instance, its output file and, in
+* the pipeline, depth blocks cycling through the channels.
+*/ // =========================================================
+
+struct Job {
+	UberSaw 			*u;
+	user_osc_param_t 	params;
+	uint32_t 			frames;		// Frames to render
+	FILE 				*file;
+	uint64_t 			hash;		// FNV-1a of the samples written
+	bool 				ok;
+};
+
+// =========================================================
+// Stage work, shared by the pipeline and the sequential loop
+// =========================================================
+
+#define FNV_OFFSET 	0xCBF29CE484222325ull
+#define FNV_PRIME 	0x00000100000001B3ull
+
+static void setupJob(Job &job, UberSaw &u, const uint32_t index, const uint32_t frames) {
+
+	u = UberSaw();
+	u.seed(index + 1);
+	ubersaw_param(u, k_user_osc_param_id1, 20);
+	ubersaw_param(u, k_user_osc_param_id2, 20);
+	ubersaw_param(u, k_user_osc_param_id4, (index * 37) % 101);
+	ubersaw_param(u, k_user_osc_param_id5, 1 + index % NUM_CHORDS);
+	ubersaw_param(u, k_user_osc_param_shape, (index * 97) % 1024);
+	ubersaw_note_on(u);
+
+	memset(&job, 0, sizeof(job));
+	job.u = &u;
+	job.params.pitch = (uint16_t)((36 + (index * 5) % 48) << 8);
+	job.frames = frames;
+	job.hash = FNV_OFFSET;
+	job.ok = true;
+}
+
+static void renderBlock(Job &job, Block &b) {
+	for(uint32_t pos = 0; pos < b.frames; pos += ENGINE_FRAMES) {
+		const uint32_t n = (b.frames - pos < ENGINE_FRAMES) ? b.frames - pos : ENGINE_FRAMES;
+		float *y = b.pcm + 2 * pos;
+		ubersaw_cycle_stereo(*job.u, &job.params, y, y + 1, 2, n);
+	}
+}
+
+static void encodeBlock(Block &b) {
+	for(uint32_t i = 0; i < 2 * b.frames; i++) {
+		const float x = clipminmaxf(-1.f, b.pcm[i], 1.f) * 32767.f;
+		b.wav[i] = (int16_t)(x < 0.f ? x - 0.5f : x + 0.5f);
+	}
+}
+
+static void writeBlock(Job &job, const Block &b) {
+	const uint8_t *p = (const uint8_t *)b.wav;
+	const size_t bytes = 2 * b.frames * sizeof(int16_t);
+	for(size_t i = 0; i < bytes; i++) {
+		job.hash ^= p[i];
+		job.hash *= FNV_PRIME;
+	}
+	if(job.file && fwrite(b.wav, 1, bytes, job.file) != bytes) {
+		job.ok = false;
+	}
+}
+
+// =========================================================
+// WAV file, header written with the final sizes on close
+// =========================================================
+
+static void put16(uint8_t *p, uint16_t x) {
+	p[0] = x & 0xFF;
+	p[1] = x >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t x) {
+	put16(p, x & 0xFFFF);
+	put16(p + 2, x >> 16);
+}
+
+static void wavHeader(uint8_t *h, const uint32_t frames) {
+	const uint32_t bytes = frames * 4;
+	memcpy(h, "RIFF", 4);
+	put32(h + 4, 36 + bytes);
+	memcpy(h + 8, "WAVEfmt ", 8);
+	put32(h + 16, 16);
+	put16(h + 20, 1); 				// PCM
+	put16(h + 22, 2); 				// Stereo
+	put32(h + 24, SAMPLERATE);
+	put32(h + 28, SAMPLERATE * 4);
+	put16(h + 32, 4);
+	put16(h + 34, 16);
+	memcpy(h + 36, "data", 4);
+	put32(h + 40, bytes);
+}
+
+static bool openWav(Job &job, const char *dir, const uint32_t index) {
+	if(dir == NULL) {
+		return true;
+	}
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/ubersaw_%04u.wav", dir, index);
+	job.file = fopen(path, "wb");
+	uint8_t h[WAV_HEADER];
+	wavHeader(h, job.frames);
+	return job.file && fwrite(h, 1, WAV_HEADER, job.file) == WAV_HEADER;
+}
+
+static void closeWav(Job &job) {
+	if(job.file && fclose(job.file) != 0) {
+		job.ok = false;
+	}
+	job.file = NULL;
+}
+
+/* // =========================================================
+* Pipeline stages. Render takes a free block (waiting if all
+* depth blocks are in flight), fills it and yields, so the
+* jobs take turns; encode and write follow it block by block
+* and write hands the block back to render.
+*/ // =========================================================
+
+struct Pipe {
+	Job 				*job;
+	std::vector<Block> 	blocks;
+	Channel<Block> 		free;
+	Channel<Block> 		rendered;
+	Channel<Block> 		encoded;
+
+	Pipe(Executor &ex, Job &j, uint32_t depth) :
+		job(&j),
+		blocks(depth),
+		free(ex, depth),
+		rendered(ex, depth),
+		encoded(ex, depth)
+	{ }
+};
+
+static Task renderStage(Executor &ex, Pipe &pipe) {
+	Job &job = *pipe.job;
+	for(uint32_t pos = 0; pos < job.frames; pos += BLOCK_FRAMES) {
+		Block *b = co_await pipe.free.receive();
+		b->frames = (job.frames - pos < BLOCK_FRAMES) ? job.frames - pos : BLOCK_FRAMES;
+		renderBlock(job, *b);
+		co_await pipe.rendered.send(b);
+		co_await ex.yield();
+	}
+	co_await pipe.rendered.send(NULL);
+}
+
+static Task encodeStage(Executor &ex, Pipe &pipe) {
+	(void)ex;
+	for(;;) {
+		Block *b = co_await pipe.rendered.receive();
+		if(b) {
+			encodeBlock(*b);
+		}
+		co_await pipe.encoded.send(b);
+		if(b == NULL) {
+			break;
+		}
+	}
+}
+
+static Task releaseBlock(Executor &ex, Pipe &pipe, Block *b) {
+	(void)ex;
+	co_await pipe.free.send(b);
+}
+
+static Task writeStage(Executor &ex, Pipe &pipe) {
+	(void)ex;
+	for(;;) {
+		Block *b = co_await pipe.encoded.receive();
+		if(b == NULL) {
+			break;
+		}
+		writeBlock(*pipe.job, *b);
+		co_await pipe.free.send(b);
+	}
+	closeWav(*pipe.job);
+}
+
+// =========================================================
+// The two ways of running the jobs
+// =========================================================
+
+static void runSequential(std::vector<Job> &jobs) {
+	static Block b;
+	for(Job &job : jobs) {
+		for(uint32_t pos = 0; pos < job.frames; pos += BLOCK_FRAMES) {
+			b.frames = (job.frames - pos < BLOCK_FRAMES) ? job.frames - pos : BLOCK_FRAMES;
+			renderBlock(job, b);
+			encodeBlock(b);
+			writeBlock(job, b);
+		}
+		closeWav(job);
+	}
+}
+
+static void runPipeline(std::vector<Job> &jobs, const uint32_t threads, const uint32_t depth) {
+
+	Executor ex(threads);
+
+	std::deque<Pipe> pipes;
+	for(Job &job : jobs) {
+		pipes.emplace_back(ex, job, depth);
+	}
+
+	// Queue every block as free, then start all the stages
+
+	for(Pipe &pipe : pipes) {
+		for(Block &b : pipe.blocks) {
+			spawn(ex, releaseBlock(ex, pipe, &b));
+		}
+	}
+	ex.wait();
+
+	for(Pipe &pipe : pipes) {
+		spawn(ex, writeStage(ex, pipe));
+		spawn(ex, encodeStage(ex, pipe));
+		spawn(ex, renderStage(ex, pipe));
+	}
+	ex.wait();
+}
+
+// =========================================================
+// Set up the jobs, run them and report
+// =========================================================
+
+struct Run {
+	double 		seconds;	// Wall time
+	uint64_t 	hash;		// Combined hash of every job
+	bool 		ok;
+};
+
+static Run run(std::vector<UberSaw> &engines, const uint32_t frames, const char *dir,
+		const bool pipeline, const uint32_t threads, const uint32_t depth) {
+
+	std::vector<Job> jobs(engines.size());
+	Run r = { 0., FNV_OFFSET, true };
+
+	for(uint32_t i = 0; i < jobs.size(); i++) {
+		setupJob(jobs[i], engines[i], i, frames);
+		if(!openWav(jobs[i], dir, i)) {
+			fprintf(stderr, "cannot write to %s\n", dir);
+			for(uint32_t k = 0; k <= i; k++) {
+				closeWav(jobs[k]);
+			}
+			r.ok = false;
+			return r;
+		}
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	if(pipeline) {
+		runPipeline(jobs, threads, depth);
+	} else {
+		runSequential(jobs);
+	}
+	r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	for(const Job &job : jobs) {
+		r.hash = (r.hash ^ job.hash) * FNV_PRIME;
+		r.ok = r.ok && job.ok;
+	}
+	return r;
+}
+
+static void printRun(const char *name, const Run &r, const uint32_t jobs, const uint32_t frames) {
+	const double audio = (double)jobs * frames / SAMPLERATE;
+	const double mb = (double)jobs * (frames * 4 + WAV_HEADER) / (1024. * 1024.);
+	printf("%-12s %9.3f %10.1f %9.1f   %016llx%s\n", name, r.seconds, audio / r.seconds, mb / r.seconds,
+			(unsigned long long)r.hash, r.ok ? "" : "  (write failed)");
+}
+
+int main(int argc, char **argv) {
+
+	uint32_t threads = 4;
+	uint32_t count = 64;
+	double seconds = 2.;
+	uint32_t depth = 4;
+	const char *dir = ".";
+	bool bench = false;
+
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			threads = (uint32_t)atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			count = (uint32_t)atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			seconds = atof(argv[++i]);
+		} else if(strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+			depth = (uint32_t)atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			dir = argv[++i];
+		} else if(strcmp(argv[i], "--bench") == 0) {
+			bench = true;
+		} else {
+			fprintf(stderr, "usage: %s [-j threads] [-n jobs] [-s seconds] [-d depth] [-o dir] [--bench]\n",
+					argv[0]);
+			return 1;
+		}
+	}
+
+	if(threads == 0 || count == 0 || depth == 0 || !(seconds > 0.)) {
+		fprintf(stderr, "threads, jobs, depth and seconds must be positive\n");
+		return 1;
+	}
+
+	const uint32_t frames = (uint32_t)(seconds * SAMPLERATE);
+
+	// Construct every engine before any render thread starts
+	// (the constructor fills the shared detune table)
+
+	std::vector<UberSaw> engines(count);
+
+	printf("%u jobs of %.2fs, %u threads, depth %u\n", count, seconds, threads, depth);
+	printf("%-12s %9s %10s %9s   %s\n", "run", "wall(s)", "x realtime", "MB/s", "audio hash");
+
+	Run seq = { 0., 0, true };
+	if(bench) {
+		seq = run(engines, frames, dir, false, threads, depth);
+		if(seq.seconds == 0.) {
+			return 1;
+		}
+		printRun("sequential", seq, count, frames);
+	}
+
+	const Run pipe = run(engines, frames, dir, true, threads, depth);
+	if(pipe.seconds == 0.) {
+		return 1;
+	}
+	printRun("pipeline", pipe, count, frames);
+
+	if(bench) {
+		printf("\nspeedup %.2fx, output %s\n", seq.seconds / pipe.seconds,
+				seq.hash == pipe.hash ? "identical" : "DIFFERS");
+	}
+
+	return (seq.ok && pipe.ok && (!bench || seq.hash == pipe.hash)) ? 0 : 1;
+}
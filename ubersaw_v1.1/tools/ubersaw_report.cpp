@@ -0,0 +1,817 @@
+/*
+ * File: ubersaw_report.cpp
+ *
+ * Host quality and CPU report for the UberSaw engine. Renders
+ * a note sweep for a set of configurations and prints the
+ * aliasing ratio, THD+N, pitch error and DC offset of each
+ * render next to the cycles per sample it took, then times a
+ * release tail against the held note and measures the cost of
+ * timestamped parameter events and of the phase drift walk
+ * against the block cycle budget, and shows what FpuGuard
+ * saves on a very low note and on the HPF decaying in
+ * silence. The pitch error is only
+ * reported for configurations without detune.
+ *
+ * With --budget it only renders the sweep and checks every
+ * render against CYCLE_BUDGET for the platform it was built
+ * for, exiting non-zero if one averages over it. With --stages
+ * (built with UBERSAW_STAGE_TIMING, make stages) it times the
+ * supersaw configuration and prints ubersaw_stage_report().
+ *
+ * Usage: ubersaw_report [--json <file>|-] [--budget] [--stages]
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "userosc.h"
+#include "../ubersaw_v1.1.hpp"
+
+// =========================================================
+// Analysis settings
+// =========================================================
+
+#define FFT_SIZE 		32768 		// 0.68s at 48KHz, 1.46Hz per bin
+#define WARMUP_FRAMES 	4800 		// Let the fade, mix ramps and HPF settle
+#define BLOCK_FRAMES 	64 			// Largest OSC_CYCLE block
+#define MAIN_LOBE 		4 			// Blackman-Harris main lobe half width (bins)
+#define SAMPLERATE 		48000.
+#define FLOOR_DB 		-200. 		// Reported for silent bands
+#define TAIL_NOTE 		48
+#define TAIL_RELEASE_MS 150.f 		// Release time constant
+#define TAIL_HOLD 		12288 		// Held frames before note off (whole blocks)
+#define TAIL_FRAMES 	96000 		// Frames rendered after note off
+#define BENCH_BLOCKS 	750 		// Blocks per timed run (1s)
+#define BENCH_RUNS 		5 			// Timed runs, the fastest is kept
+#define LOW_NOTE 		0 			// Lowest MIDI note (8.2Hz)
+#define FLT_MIN_NORMAL 	1.17549435e-038f 	// Smallest normal float
+
+/* // =========================================================
+* Configurations. The spectral figures are measured against
+* the harmonic series of the note, each harmonic widened by
+* the detune spread of the side oscillators, so they apply to
+* the supersaw alone: the secondary oscillators stay muted.
+*/ // =========================================================
+
+struct Config {
+	const char 	*name;
+	uint16_t 	detune; 	// Parameter 4 [0-100]
+	uint16_t 	shape; 		// Supersaw mix (A knob) [0-1023]
+	bool 		pitch; 		// Pitch error is meaningful (no detune)
+};
+
+static const Config configs[] = {
+	{ "tight", 0, 0, true },
+	{ "supersaw", 50, 512, false },
+	{ "wide", 100, 1023, false }
+};
+
+static const uint8_t notes[] = { 24, 36, 48, 60, 72, 84, 96, 108 };
+
+#define NUM_CONFIGS 	(sizeof(configs) / sizeof(configs[0]))
+#define NUM_NOTES 		(sizeof(notes) / sizeof(notes[0]))
+
+// =========================================================
+// Result of one render
+// =========================================================
+
+struct Result {
+	const char 	*config;
+	uint8_t 	note;
+	double 		f0;				// Expected fundamental (Hz)
+	double 		alias_db;		// Inharmonic / harmonic energy
+	double 		thdn_db;		// Everything but the fundamental / total
+	double 		cents;			// Measured - expected pitch
+	bool 		tuned;			// cents is valid
+	double 		dc;				// Mean of the output
+	double 		cycles;			// Cycles per sample
+	uint32_t 	peak;			// Worst block (cycles)
+};
+
+/* // =========================================================
+* Release tail cost, by what each block rendered: the held
+* note, each voice tier of the release, and silence.
+*/ // =========================================================
+
+enum {
+	k_tail_held = 0,
+	k_tail_full,
+	k_tail_medium,
+	k_tail_low,
+	k_tail_silent,
+	k_num_tail_phases
+};
+
+static const char *tail_names[k_num_tail_phases] = { "held", "7 voices", "5 voices", "3 voices", "silent" };
+
+struct Tail {
+	uint64_t 	cycles[k_num_tail_phases];
+	uint32_t 	frames[k_num_tail_phases];
+};
+
+/* // =========================================================
+* Timestamped parameter events queued per block for the event
+* cost benchmark (the queue holds up to EVENT_QUEUE_SIZE).
+*/ // =========================================================
+
+static const uint32_t event_counts[] = { 0, 1, 8, 64 };
+
+#define NUM_EVENT_COUNTS 	(sizeof(event_counts) / sizeof(event_counts[0]))
+
+// =========================================================
+// Results of the timing benchmarks
+// =========================================================
+
+struct Bench {
+	double 		events[NUM_EVENT_COUNTS];	// Cycles per sample
+	double 		drift_walk;					// Cycles per updateDrift() call
+	double 		drift_off;					// Cycles per sample, drift at 0
+	double 		drift_full;					// Cycles per sample, drift at 1023
+};
+
+/* // =========================================================
+* Denormal cases, each timed with the FpuGuard flushing (0)
+* and leaving the FPU mode alone (1).
+*/ // =========================================================
+
+enum {
+	k_denormal_low_note = 0, 	// Engine at LOW_NOTE
+	k_denormal_hpf_decay, 		// Engine HPF fed silence
+	k_num_denormal_cases
+};
+
+static const char *const denormal_names[k_num_denormal_cases] = {
+	"low note", "hpf decay"
+};
+
+struct Denormal {
+	double 		cycles[k_num_denormal_cases][2];	// Cycles per sample
+	uint32_t 	peak[k_num_denormal_cases][2];		// Worst block (cycles)
+	uint32_t 	subnormal;							// Subnormal HPF outputs
+};
+
+static float 	signal[FFT_SIZE];
+static double 	re[FFT_SIZE];
+static double 	im[FFT_SIZE];
+static double 	power[FFT_SIZE / 2 + 1];
+
+/* // =========================================================
+* In-place radix-2 FFT.
+*/ // =========================================================
+
+static void fft(double *xr, double *xi, const uint32_t n) {
+
+	// Bit reversal permutation
+
+	for(uint32_t i = 1, j = 0; i < n; i++) {
+		uint32_t bit = n >> 1;
+		for(; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j ^= bit;
+		if(i < j) {
+			double t = xr[i]; xr[i] = xr[j]; xr[j] = t;
+			t = xi[i]; xi[i] = xi[j]; xi[j] = t;
+		}
+	}
+
+	// Butterflies
+
+	for(uint32_t len = 2; len <= n; len <<= 1) {
+		const double a = -2. * M_PI / len;
+		const double wr = cos(a);
+		const double wi = sin(a);
+		for(uint32_t i = 0; i < n; i += len) {
+			double cr = 1.;
+			double ci = 0.;
+			for(uint32_t k = 0; k < len / 2; k++) {
+				const uint32_t p = i + k;
+				const uint32_t q = p + len / 2;
+				const double tr = xr[q] * cr - xi[q] * ci;
+				const double ti = xr[q] * ci + xi[q] * cr;
+				xr[q] = xr[p] - tr;
+				xi[q] = xi[p] - ti;
+				xr[p] += tr;
+				xi[p] += ti;
+				const double t = cr * wr - ci * wi;
+				ci = cr * wi + ci * wr;
+				cr = t;
+			}
+		}
+	}
+}
+
+/* // =========================================================
+* Render FFT_SIZE frames of one note after the warm up,
+* timing every block. Returns the detune spread in use.
+*/ // =========================================================
+
+static float render(const Config &c, const uint8_t note, Result &r) {
+
+	static UberSaw u;
+	u = UberSaw();
+
+	ubersaw_param(u, k_user_osc_param_id1, 0);
+	ubersaw_param(u, k_user_osc_param_id2, 0);
+	ubersaw_param(u, k_user_osc_param_id3, 0);
+	ubersaw_param(u, k_user_osc_param_id4, c.detune);
+	ubersaw_param(u, k_user_osc_param_shape, c.shape);
+	ubersaw_param(u, k_user_osc_param_shiftshape, 0);
+	ubersaw_note_on(u);
+
+	user_osc_param_t params;
+	memset(&params, 0, sizeof(params));
+	params.pitch = (uint16_t)(note << 8);
+
+	int32_t buf[BLOCK_FRAMES];
+	for(uint32_t n = 0; n < WARMUP_FRAMES; n += BLOCK_FRAMES) {
+		ubersaw_cycle(u, &params, buf, BLOCK_FRAMES);
+	}
+
+	uint64_t total = 0;
+	uint32_t peak = 0;
+	for(uint32_t n = 0; n < FFT_SIZE; n += BLOCK_FRAMES) {
+		const uint32_t start = cyclesNow();
+		ubersaw_cycle(u, &params, buf, BLOCK_FRAMES);
+		const uint32_t elapsed = cyclesNow() - start;
+		total += elapsed;
+		if(elapsed > peak) {
+			peak = elapsed;
+		}
+		for(uint32_t i = 0; i < BLOCK_FRAMES; i++) {
+			signal[n + i] = q31_to_f32(buf[i]);
+		}
+	}
+
+	r.cycles = (double)total / FFT_SIZE;
+	r.peak = peak;
+	return u.params.detune;
+}
+
+/* // =========================================================
+* Hold the supersaw configuration for TAIL_HOLD frames, release
+* it and render TAIL_FRAMES more, filing each block's cycles
+* under the tier it rendered at.
+*/ // =========================================================
+
+static void releaseTail(Tail &t) {
+
+	memset(&t, 0, sizeof(t));
+
+	static UberSaw u;
+	u = UberSaw();
+
+	ubersaw_param(u, k_user_osc_param_id1, 0);
+	ubersaw_param(u, k_user_osc_param_id2, 0);
+	ubersaw_param(u, k_user_osc_param_id3, 0);
+	ubersaw_param(u, k_user_osc_param_id4, 50);
+	ubersaw_param(u, k_user_osc_param_shape, 512);
+	ubersaw_param(u, k_user_osc_param_shiftshape, 0);
+	ubersaw_set_envelope(u, 0.f, TAIL_RELEASE_MS);
+	ubersaw_note_on(u);
+
+	user_osc_param_t params;
+	memset(&params, 0, sizeof(params));
+	params.pitch = (uint16_t)(TAIL_NOTE << 8);
+
+	int32_t buf[BLOCK_FRAMES];
+	for(uint32_t n = 0; n < TAIL_HOLD + TAIL_FRAMES; n += BLOCK_FRAMES) {
+		if(n == TAIL_HOLD) {
+			ubersaw_note_off(u);
+		}
+		uint32_t phase = k_tail_held;
+		if(n >= TAIL_HOLD) {
+			phase = (u.env.stage == k_env_off) ? (uint32_t)k_tail_silent : k_tail_full + u.quality.tier;
+		}
+		const uint32_t start = cyclesNow();
+		ubersaw_cycle(u, &params, buf, BLOCK_FRAMES);
+		t.cycles[phase] += cyclesNow() - start;
+		t.frames[phase] += BLOCK_FRAMES;
+	}
+}
+
+/* // =========================================================
+* Render BENCH_BLOCKS blocks of the supersaw configuration with
+* the phase drift control at drift and count events per block,
+* spread evenly across it and each moving mix A, so every one
+* splits the block and updates the control state. Queueing is
+* the host's work and is not timed. Returns the cycles per
+* sample of the fastest run.
+*/ // =========================================================
+
+static double blockCost(const uint32_t count, const uint16_t drift) {
+
+	static UberSaw u;
+	double best = 0.;
+
+	for(uint32_t run = 0; run < BENCH_RUNS; run++) {
+
+		u = UberSaw();
+		ubersaw_param(u, k_user_osc_param_id4, 50);
+		ubersaw_param(u, k_user_osc_param_shape, 512);
+		ubersaw_param(u, k_user_osc_param_shiftshape, drift);
+		ubersaw_note_on(u);
+
+		user_osc_param_t params;
+		memset(&params, 0, sizeof(params));
+		params.pitch = (uint16_t)(TAIL_NOTE << 8);
+
+		int32_t buf[BLOCK_FRAMES];
+		uint64_t total = 0;
+		for(uint32_t b = 0; b < BENCH_BLOCKS; b++) {
+			for(uint32_t e = 0; e < count; e++) {
+				u.events.push(u.state.clock + e * BLOCK_FRAMES / count, k_user_osc_param_id1, (b + e) & 1 ? 10 : 0);
+			}
+			const uint32_t start = cyclesNow();
+			ubersaw_cycle(u, &params, buf, BLOCK_FRAMES);
+			total += cyclesNow() - start;
+		}
+
+		const double cycles = (double)total / (BENCH_BLOCKS * BLOCK_FRAMES);
+		if(run == 0 || cycles < best) {
+			best = cycles;
+		}
+	}
+
+	return best;
+}
+
+/* // =========================================================
+* Time the per-block drift walk on its own: BENCH_BLOCKS calls
+* of updateDrift() for a BLOCK_FRAMES block. Returns the cycles
+* per call of the fastest run.
+*/ // =========================================================
+
+static double driftCost(void) {
+
+	static UberSaw u;
+	u = UberSaw();
+	double best = 0.;
+
+	for(uint32_t run = 0; run < BENCH_RUNS; run++) {
+		const uint32_t start = cyclesNow();
+		for(uint32_t b = 0; b < BENCH_BLOCKS; b++) {
+			u.updateDrift(BLOCK_FRAMES);
+		}
+		const double cycles = (double)(cyclesNow() - start) / BENCH_BLOCKS;
+		if(run == 0 || cycles < best) {
+			best = cycles;
+		}
+	}
+
+	return best;
+}
+
+#ifdef UBERSAW_STAGE_TIMING
+
+/* // =========================================================
+* Render BENCH_BLOCKS blocks of the supersaw configuration after
+* the warm up and print the cycles charged to each render
+* stage, in folded stack format, then per sample.
+*/ // =========================================================
+
+static void printStages(void) {
+
+	static UberSaw u;
+	u = UberSaw();
+	ubersaw_param(u, k_user_osc_param_id4, 50);
+	ubersaw_param(u, k_user_osc_param_shape, 512);
+	ubersaw_note_on(u);
+
+	user_osc_param_t params;
+	memset(&params, 0, sizeof(params));
+	params.pitch = (uint16_t)(TAIL_NOTE << 8);
+
+	int32_t buf[BLOCK_FRAMES];
+	for(uint32_t n = 0; n < WARMUP_FRAMES; n += BLOCK_FRAMES) {
+		ubersaw_cycle(u, &params, buf, BLOCK_FRAMES);
+	}
+
+	Stages &stages = ubersaw_stages();
+	stages.reset();
+	for(uint32_t b = 0; b < BENCH_BLOCKS; b++) {
+		ubersaw_cycle(u, &params, buf, BLOCK_FRAMES);
+	}
+
+	char report[1024];
+	ubersaw_stage_report(report, sizeof(report));
+	fputs(report, stdout);
+
+	printf("\nstages (note %d, supersaw), cycles per sample over %u frames\n", TAIL_NOTE, stages.frames);
+	uint64_t total = 0;
+	for(uint32_t i = 0; i < k_num_stages; i++) {
+		total += stages.cycles[i];
+	}
+	const char *line = report;
+	for(uint32_t i = 0; i < k_num_stages; i++) {
+		const char *end = strchr(line, ' ');
+		printf("%-24.*s %9.1f\n", (int)(end - line), line, (double)stages.cycles[i] / stages.frames);
+		line = strchr(end, '\n') + 1;
+	}
+	printf("%-24s %9.1f\n", "total", (double)total / stages.frames);
+}
+
+#endif
+
+/* // =========================================================
+* Time BENCH_BLOCKS blocks of the supersaw configuration at
+* LOW_NOTE, then feed the engine's HPF, as the note left it,
+* BENCH_BLOCKS blocks of silence, with and without the guard.
+* Both the mean and the worst block are the lowest of
+* BENCH_RUNS runs, which keeps the host's own interruptions
+* out of the worst block.
+*/ // =========================================================
+
+static void denormalCost(Denormal &d) {
+
+	static UberSaw u;
+	memset(&d, 0, sizeof(d));
+
+	for(uint32_t mode = 0; mode < 2; mode++) {
+		for(uint32_t run = 0; run < BENCH_RUNS; run++) {
+
+			u = UberSaw();
+			u.flush_denormals = mode == 0;
+			ubersaw_param(u, k_user_osc_param_id4, 50);
+			ubersaw_param(u, k_user_osc_param_shape, 512);
+			ubersaw_note_on(u);
+
+			user_osc_param_t params;
+			memset(&params, 0, sizeof(params));
+			params.pitch = (uint16_t)(LOW_NOTE << 8);
+
+			int32_t buf[BLOCK_FRAMES];
+			for(uint32_t n = 0; n < WARMUP_FRAMES; n += BLOCK_FRAMES) {
+				ubersaw_cycle(u, &params, buf, BLOCK_FRAMES);
+			}
+
+			uint64_t total[k_num_denormal_cases] = { 0, 0 };
+			uint32_t peak[k_num_denormal_cases] = { 0, 0 };
+			for(uint32_t b = 0; b < BENCH_BLOCKS; b++) {
+				const uint32_t start = cyclesNow();
+				ubersaw_cycle(u, &params, buf, BLOCK_FRAMES);
+				const uint32_t elapsed = cyclesNow() - start;
+				total[k_denormal_low_note] += elapsed;
+				if(elapsed > peak[k_denormal_low_note]) {
+					peak[k_denormal_low_note] = elapsed;
+				}
+			}
+
+			uint32_t subnormal = 0;
+			{
+				const FpuGuard fpu(mode == 0);
+				dsp::BiQuad &hpf = u.HPF;
+				for(uint32_t b = 0; b < BENCH_BLOCKS; b++) {
+					float out[BLOCK_FRAMES];
+					const uint32_t start = cyclesNow();
+					for(uint32_t i = 0; i < BLOCK_FRAMES; i++) {
+						out[i] = hpf.process_fo(ZEROF);
+					}
+					const uint32_t elapsed = cyclesNow() - start;
+					total[k_denormal_hpf_decay] += elapsed;
+					if(elapsed > peak[k_denormal_hpf_decay]) {
+						peak[k_denormal_hpf_decay] = elapsed;
+					}
+					for(uint32_t i = 0; i < BLOCK_FRAMES; i++) {
+						if(out[i] != ZEROF && fabsf(out[i]) < FLT_MIN_NORMAL) {
+							subnormal++;
+						}
+					}
+				}
+			}
+
+			for(uint32_t c = 0; c < k_num_denormal_cases; c++) {
+				const double cycles = (double)total[c] / (BENCH_BLOCKS * BLOCK_FRAMES);
+				if(run == 0 || cycles < d.cycles[c][mode]) {
+					d.cycles[c][mode] = cycles;
+				}
+				if(run == 0 || peak[c] < d.peak[c][mode]) {
+					d.peak[c][mode] = peak[c];
+				}
+			}
+			if(mode == 1 && subnormal > d.subnormal) {
+				d.subnormal = subnormal;
+			}
+		}
+	}
+}
+
+static double tailCycles(const Tail &t, const uint32_t phase) {
+	return t.frames[phase] ? (double)t.cycles[phase] / t.frames[phase] : 0.;
+}
+
+// Cycles per sample over the whole tail
+
+static double tailAverage(const Tail &t) {
+	uint64_t cycles = 0;
+	uint32_t frames = 0;
+	for(uint32_t i = k_tail_full; i < k_num_tail_phases; i++) {
+		cycles += t.cycles[i];
+		frames += t.frames[i];
+	}
+	return frames ? (double)cycles / frames : 0.;
+}
+
+// =========================================================
+// Energy ratio in dB, floored for silent bands
+// =========================================================
+
+static double ratioDb(const double num, const double den) {
+	if(num <= 0. || den <= 0.) {
+		return FLOOR_DB;
+	}
+	const double db = 10. * log10(num / den);
+	return db > FLOOR_DB ? db : FLOOR_DB;
+}
+
+/* // =========================================================
+* Analyse the rendered signal. Bins within the main lobe of a
+* harmonic, widened by the detune spread and capped at half
+* the harmonic spacing, count as harmonic; every other bin
+* above DC is aliasing or noise. The pitch is the power
+* weighted centroid of the fundamental band. It resolves the
+* centre oscillator only while the side oscillators sit on the
+* note (the tight configuration); with detune it measures the
+* beating of the stack, so it is left out.
+*/ // =========================================================
+
+static void analyse(const float detune, Result &r) {
+
+	const double bin_hz = SAMPLERATE / FFT_SIZE;
+	const double f0 = r.f0;
+
+	// DC offset after the HPF
+
+	double sum = 0.;
+	for(uint32_t i = 0; i < FFT_SIZE; i++) {
+		sum += signal[i];
+	}
+	r.dc = sum / FFT_SIZE;
+
+	// 4-term Blackman-Harris window
+
+	for(uint32_t i = 0; i < FFT_SIZE; i++) {
+		const double x = 2. * M_PI * i / FFT_SIZE;
+		const double w = 0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2. * x) - 0.01168 * cos(3. * x);
+		re[i] = signal[i] * w;
+		im[i] = 0.;
+	}
+
+	fft(re, im, FFT_SIZE);
+
+	for(uint32_t k = 0; k <= FFT_SIZE / 2; k++) {
+		power[k] = re[k] * re[k] + im[k] * im[k];
+	}
+
+	// Harmonic bands
+
+	static bool harmonic[FFT_SIZE / 2 + 1];
+	memset(harmonic, 0, sizeof(harmonic));
+
+	const double spacing = 0.5 * f0 / bin_hz;
+	double fund = 0.;
+	double centroid = 0.;
+
+	for(uint32_t h = 1; h * f0 < 0.5 * SAMPLERATE; h++) {
+		const double centre = h * f0 / bin_hz;
+		double guard = MAIN_LOBE + h * f0 * detune / bin_hz;
+		if(guard > spacing) {
+			guard = spacing;
+		}
+		int32_t lo = (int32_t)ceil(centre - guard);
+		int32_t hi = (int32_t)floor(centre + guard);
+		if(lo <= MAIN_LOBE) {
+			lo = MAIN_LOBE + 1;
+		}
+		if(hi > FFT_SIZE / 2) {
+			hi = FFT_SIZE / 2;
+		}
+		for(int32_t k = lo; k <= hi; k++) {
+			harmonic[k] = true;
+			if(h == 1) {
+				fund += power[k];
+				centroid += power[k] * k;
+			}
+		}
+	}
+
+	double harm = 0.;
+	double inharm = 0.;
+	for(uint32_t k = MAIN_LOBE + 1; k <= FFT_SIZE / 2; k++) {
+		if(harmonic[k]) {
+			harm += power[k];
+		} else {
+			inharm += power[k];
+		}
+	}
+
+	r.alias_db = ratioDb(inharm, harm);
+	r.thdn_db = ratioDb(harm + inharm - fund, harm + inharm);
+	r.cents = (r.tuned && fund > 0.) ? 1200. * log2((centroid / fund) * bin_hz / f0) : 0.;
+}
+
+// =========================================================
+// Output
+// =========================================================
+
+static void printTable(const Result *results, const uint32_t count) {
+	printf("%-10s %4s %9s %10s %10s %10s %12s %9s %9s\n", "config", "note", "f0(Hz)",
+			"alias(dB)", "THD+N(dB)", "pitch(ct)", "DC", "cyc/smp", "peak/blk");
+	for(uint32_t i = 0; i < count; i++) {
+		const Result &r = results[i];
+		char cents[16] = "-";
+		if(r.tuned) {
+			snprintf(cents, sizeof(cents), "%.3f", r.cents);
+		}
+		printf("%-10s %4u %9.2f %10.1f %10.1f %10s %12.3e %9.1f %9u\n", r.config, r.note, r.f0,
+				r.alias_db, r.thdn_db, cents, r.dc, r.cycles, r.peak);
+	}
+}
+
+static void printTail(const Tail &t) {
+	printf("\nrelease tail (note %d, %.0fms release): %.1f cyc/smp held, %.1f over the tail\n",
+			TAIL_NOTE, TAIL_RELEASE_MS, tailCycles(t, k_tail_held), tailAverage(t));
+	printf("%-10s %9s %9s\n", "phase", "ms", "cyc/smp");
+	for(uint32_t i = 0; i < k_num_tail_phases; i++) {
+		printf("%-10s %9.1f %9.1f\n", tail_names[i], t.frames[i] * 1000. / SAMPLERATE, tailCycles(t, i));
+	}
+}
+
+static void printBench(const Bench &b) {
+	printf("\nparameter events (note %d, supersaw): cycles per sample by events per block\n", TAIL_NOTE);
+	printf("%-10s %9s %9s\n", "events", "cyc/smp", "overhead");
+	for(uint32_t i = 0; i < NUM_EVENT_COUNTS; i++) {
+		printf("%-10u %9.1f %8.1f%%\n", event_counts[i], b.events[i],
+				100. * (b.events[i] / b.events[0] - 1.));
+	}
+	printf("\nphase drift: walk %.1f cyc/block (%.2f%% of the %d-cycle block budget), "
+			"%.1f cyc/smp at 0, %.1f at full\n", b.drift_walk,
+			100. * b.drift_walk / (CYCLE_BUDGET * BLOCK_FRAMES), CYCLE_BUDGET * BLOCK_FRAMES,
+			b.drift_off, b.drift_full);
+}
+
+/* // =========================================================
+* Check the sweep against the platform budget. Host cycles only
+* stand in for the Cortex-M4's, so the render averages are
+* checked and the worst block, which takes the host's own
+* interruptions, is shown alongside.
+*/ // =========================================================
+
+static bool checkBudget(const Result *results, const uint32_t count) {
+	const Result *worst = &results[0];
+	uint32_t peak = 0;
+	for(uint32_t i = 0; i < count; i++) {
+		if(results[i].cycles > worst->cycles) {
+			worst = &results[i];
+		}
+		if(results[i].peak > peak) {
+			peak = results[i].peak;
+		}
+	}
+	const bool ok = worst->cycles <= CYCLE_BUDGET;
+	printf("budget %d cyc/smp: worst render %.1f cyc/smp (%s, note %u), worst block %.1f cyc/smp: %s\n",
+			CYCLE_BUDGET, worst->cycles, worst->config, worst->note, (double)peak / BLOCK_FRAMES,
+			ok ? "ok" : "OVER");
+	return ok;
+}
+
+static void printDenormal(const Denormal &d) {
+	printf("\ndenormals (note %d, supersaw): FpuGuard flushing vs FPU mode left alone\n", LOW_NOTE);
+	printf("%-10s %9s %9s %9s %9s\n", "case", "cyc/smp", "peak/blk", "no guard", "peak/blk");
+	for(uint32_t c = 0; c < k_num_denormal_cases; c++) {
+		printf("%-10s %9.1f %9u %9.1f %9u\n", denormal_names[c], d.cycles[c][0], d.peak[c][0],
+				d.cycles[c][1], d.peak[c][1]);
+	}
+	printf("subnormal HPF outputs without the guard: %u of %u\n", d.subnormal, BENCH_BLOCKS * BLOCK_FRAMES);
+}
+
+static void writeJson(FILE *f, const Result *results, const uint32_t count, const Tail &t,
+		const Bench &b, const Denormal &d) {
+	fprintf(f, "{\n  \"samplerate\": %d,\n  \"fft_size\": %d,\n  \"block_frames\": %d,\n  \"results\": [\n",
+			(int)SAMPLERATE, FFT_SIZE, BLOCK_FRAMES);
+	for(uint32_t i = 0; i < count; i++) {
+		const Result &r = results[i];
+		char cents[32] = "null";
+		if(r.tuned) {
+			snprintf(cents, sizeof(cents), "%.4f", r.cents);
+		}
+		fprintf(f, "    { \"config\": \"%s\", \"note\": %u, \"f0_hz\": %.4f, \"alias_db\": %.2f, "
+				"\"thdn_db\": %.2f, \"pitch_cents\": %s, \"dc\": %.6e, \"cycles_per_sample\": %.2f, "
+				"\"peak_block_cycles\": %u }%s\n", r.config, r.note, r.f0, r.alias_db, r.thdn_db,
+				cents, r.dc, r.cycles, r.peak, i + 1 < count ? "," : "");
+	}
+	fprintf(f, "  ],\n  \"release_tail\": {\n    \"note\": %d,\n    \"release_ms\": %.1f,\n"
+			"    \"tail_cycles_per_sample\": %.2f,\n    \"phases\": [\n", TAIL_NOTE, TAIL_RELEASE_MS,
+			tailAverage(t));
+	for(uint32_t i = 0; i < k_num_tail_phases; i++) {
+		fprintf(f, "      { \"phase\": \"%s\", \"ms\": %.1f, \"cycles_per_sample\": %.2f }%s\n",
+				tail_names[i], t.frames[i] * 1000. / SAMPLERATE, tailCycles(t, i),
+				i + 1 < k_num_tail_phases ? "," : "");
+	}
+	fprintf(f, "    ]\n  },\n  \"events\": [\n");
+	for(uint32_t i = 0; i < NUM_EVENT_COUNTS; i++) {
+		fprintf(f, "    { \"per_block\": %u, \"cycles_per_sample\": %.2f }%s\n", event_counts[i],
+				b.events[i], i + 1 < NUM_EVENT_COUNTS ? "," : "");
+	}
+	fprintf(f, "  ],\n  \"drift\": { \"walk_cycles_per_block\": %.2f, \"block_budget\": %d, "
+			"\"cycles_per_sample_off\": %.2f, \"cycles_per_sample_full\": %.2f },\n", b.drift_walk,
+			CYCLE_BUDGET * BLOCK_FRAMES, b.drift_off, b.drift_full);
+	fprintf(f, "  \"denormals\": {\n    \"note\": %d,\n    \"subnormal_hpf_outputs\": %u,\n"
+			"    \"cases\": [\n", LOW_NOTE, d.subnormal);
+	for(uint32_t c = 0; c < k_num_denormal_cases; c++) {
+		fprintf(f, "      { \"case\": \"%s\", \"cycles_per_sample\": %.2f, \"peak_block_cycles\": %u, "
+				"\"no_guard_cycles_per_sample\": %.2f, \"no_guard_peak_block_cycles\": %u }%s\n",
+				denormal_names[c], d.cycles[c][0], d.peak[c][0], d.cycles[c][1], d.peak[c][1],
+				c + 1 < k_num_denormal_cases ? "," : "");
+	}
+	fprintf(f, "    ]\n  }\n}\n");
+}
+
+int main(int argc, char **argv) {
+
+	const char *json = NULL;
+	bool budget = false;
+	bool stages = false;
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json = argv[++i];
+		} else if(strcmp(argv[i], "--budget") == 0) {
+			budget = true;
+		} else if(strcmp(argv[i], "--stages") == 0) {
+			stages = true;
+		} else {
+			fprintf(stderr, "usage: %s [--json <file>|-] [--budget] [--stages]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	cyclesInit();
+
+	if(stages) {
+#ifdef UBERSAW_STAGE_TIMING
+		printStages();
+		return 0;
+#else
+		fprintf(stderr, "built without UBERSAW_STAGE_TIMING, use make stages\n");
+		return 1;
+#endif
+	}
+
+	static Result results[NUM_CONFIGS * NUM_NOTES];
+	uint32_t count = 0;
+
+	for(uint32_t c = 0; c < NUM_CONFIGS; c++) {
+		for(uint32_t n = 0; n < NUM_NOTES; n++) {
+			Result &r = results[count++];
+			r.config = configs[c].name;
+			r.note = notes[n];
+			r.f0 = osc_w0f_for_note(notes[n], 0) * SAMPLERATE;
+			r.tuned = configs[c].pitch;
+			const float detune = render(configs[c], notes[n], r);
+			if(!budget) {
+				analyse(detune, r);
+			}
+		}
+	}
+
+	if(budget) {
+		return checkBudget(results, count) ? 0 : 1;
+	}
+
+	static Tail tail;
+	releaseTail(tail);
+
+	static Bench bench;
+	for(uint32_t i = 0; i < NUM_EVENT_COUNTS; i++) {
+		bench.events[i] = blockCost(event_counts[i], 0);
+	}
+	bench.drift_walk = driftCost();
+	bench.drift_off = bench.events[0];
+	bench.drift_full = blockCost(0, 1023);
+
+	static Denormal denormal;
+	denormalCost(denormal);
+
+	if(json == NULL || strcmp(json, "-") != 0) {
+		printTable(results, count);
+		printTail(tail);
+		printBench(bench);
+		printDenormal(denormal);
+	}
+
+	if(json != NULL) {
+		FILE *f = strcmp(json, "-") == 0 ? stdout : fopen(json, "w");
+		if(f == NULL) {
+			fprintf(stderr, "cannot write %s\n", json);
+			return 1;
+		}
+		writeJson(f, results, count, tail, bench, denormal);
+		if(f != stdout) {
+			fclose(f);
+		}
+	}
+
+	return 0;
+}
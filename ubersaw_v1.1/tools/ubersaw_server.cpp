@@ -0,0 +1,787 @@
+/*
+ * File: ubersaw_server.cpp
+ *
+ * Local render service for host builds (C++17, POSIX). Accepts
+ * jobs, a parameter set and a note sequence, as text lines on a
+ * UNIX domain socket and renders them on a pool of pre-warmed
+ * engine instances, one worker thread each.
+ *
+ * PCM is not written to the socket. Every worker renders into
+ * its own RenderCache, a file in shared memory, and replies
+ * with the cache file, byte offset and length of the render. A
+ * client maps the file read-only and reads the samples in
+ * place. A repeated job is served from the cache without
+ * rendering: jobs go to a worker by a hash of the job, so the
+ * same job always lands on the same cache.
+ *
+ * Protocol, one line per request:
+ *
+ *   RENDER [seed=<n>] [format=mono|stereo] [params=<i>:<v>,...]
+ *          notes=<note>:<frames>[:<gate>],...
+ *     -> OK <cache file> <offset> <frames> <key> hit|miss
+ *     -> ERR <reason>
+ *
+ *   STATS
+ *     -> text metrics, one "name value" per line, then END
+ *
+ * Parameters are OSC_PARAM indices and values, applied in order
+ * to a fresh engine. The notes play one after another: each
+ * lasts frames, and note off comes after gate frames (default
+ * the whole note). Mono renders are Q31, stereo renders are
+ * interleaved float (k_cache_q31 and k_cache_f32_stereo).
+ *
+ * A render stays in the file until its worker evicts it for a
+ * later miss. A client that keeps samples for longer should
+ * copy them, or check that the index still holds the key at
+ * that offset after reading, as --client does.
+ *
+ * Usage: ubersaw_server [-s socket] [-m cache prefix] [-j workers]
+ *                       [-c cache MB per worker]
+ *        ubersaw_server --client <socket> <request...>
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "userosc.h"
+#include "ubersaw_cache.hpp"
+
+// =========================================================
+// Settings
+// =========================================================
+
+#define SAMPLERATE 		48000
+#define ENGINE_FRAMES 	64 			// Frames per engine call
+#define WARMUP_FRAMES 	48000 		// Frames rendered by each worker at start (1s)
+#define MAX_WORKERS 	64
+#define MAX_JOB_PARAMS 	64
+#define MAX_JOB_NOTES 	256
+#define MAX_JOB_FRAMES 	(60 * SAMPLERATE) 	// Longest job (60s)
+#define MAX_LINE 		8192 		// Longest request line
+#define LATENCY_BINS 	32 			// Power of two microsecond bins
+
+#define FNV_OFFSET 	0xCBF29CE484222325ull
+#define FNV_PRIME 	0x00000100000001B3ull
+
+static inline void hashBytes(uint64_t &h, const void *data, uint32_t size) {
+	const uint8_t *p = (const uint8_t *)data;
+	for(uint32_t i = 0; i < size; i++) {
+		h ^= p[i];
+		h *= FNV_PRIME;
+	}
+}
+
+static inline double now(void) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// =========================================================
+// One job, parsed from a RENDER line
+// =========================================================
+
+struct Note {
+	uint16_t 	note;		// MIDI note [0-127]
+	uint32_t 	frames;		// Length
+	uint32_t 	gate;		// Frames before note off
+};
+
+struct Job {
+	uint32_t 	seed;
+	uint32_t 	format;		// k_cache_*
+	uint32_t 	num_params;
+	uint16_t 	params[MAX_JOB_PARAMS][2];
+	uint32_t 	num_notes;
+	Note 		notes[MAX_JOB_NOTES];
+	uint32_t 	frames;		// Sum of the note lengths
+
+	// Result, filled in by the worker
+
+	const char 	*error;
+	uint64_t 	key;
+	uint64_t 	offset;		// Byte offset in the worker's cache file
+	uint32_t 	worker;
+	bool 		hit;
+
+	// Completion
+
+	std::mutex 				lock;
+	std::condition_variable done_cv;
+	bool 					done;
+};
+
+/* // =========================================================
+* Metrics, updated by the workers and connection threads and
+* read by STATS.
+*/ // =========================================================
+
+struct Metrics {
+	std::atomic<uint64_t> 	jobs;
+	std::atomic<uint64_t> 	errors;
+	std::atomic<uint64_t> 	hits;
+	std::atomic<uint64_t> 	misses;
+	std::atomic<uint64_t> 	evictions;
+	std::atomic<uint64_t> 	frames_rendered;	// Frames rendered on misses
+	std::atomic<uint64_t> 	frames_served;		// Frames returned, hits included
+	std::atomic<uint64_t> 	render_ns;			// Time spent rendering misses
+	std::atomic<uint64_t> 	latency_us;			// Sum over all jobs
+	std::atomic<uint64_t> 	latency_max_us;
+	std::atomic<uint64_t> 	latency[LATENCY_BINS];	// Bin i: [2^i, 2^(i+1)) us
+};
+
+static Metrics metrics;
+static double started;
+
+static void recordLatency(uint64_t us) {
+	uint32_t bin = 0;
+	while(bin < LATENCY_BINS - 1 && (us >> (bin + 1))) {
+		bin++;
+	}
+	metrics.latency[bin]++;
+	metrics.latency_us += us;
+	uint64_t max = metrics.latency_max_us.load();
+	while(us > max && !metrics.latency_max_us.compare_exchange_weak(max, us)) { }
+}
+
+// Upper edge of the bin holding quantile q (us)
+
+static uint64_t latencyQuantile(double q) {
+	uint64_t total = 0;
+	for(int i = 0; i < LATENCY_BINS; i++) {
+		total += metrics.latency[i];
+	}
+	const uint64_t rank = (uint64_t)ceil(q * total);
+	uint64_t seen = 0;
+	for(int i = 0; i < LATENCY_BINS; i++) {
+		seen += metrics.latency[i];
+		if(total && seen >= rank) {
+			return (uint64_t)2 << i;
+		}
+	}
+	return 0;
+}
+
+/* // =========================================================
+* Worker: one pre-warmed engine, one cache file and a job
+* queue. Only the worker thread touches its engine and cache.
+*/ // =========================================================
+
+class Worker {
+public:
+	Worker(void) :
+		stop(false)
+	{ }
+
+	bool open(const char *cache_path, uint64_t capacity) {
+		path = cache_path;
+		return cache.open(cache_path, capacity);
+	}
+
+	// Warm up on the calling thread (before any worker starts)
+
+	void warm(void) {
+		static float buf[2 * ENGINE_FRAMES];
+		UberSaw u = base;
+		user_osc_param_t params;
+		memset(&params, 0, sizeof(params));
+		params.pitch = 60 << 8;
+		ubersaw_note_on(u);
+		for(uint32_t pos = 0; pos < WARMUP_FRAMES; pos += ENGINE_FRAMES) {
+			ubersaw_cycle_stereo(u, &params, buf, buf + 1, 2, ENGINE_FRAMES);
+		}
+		voice = base;
+	}
+
+	void start(void) {
+		thread = std::thread([this] { run(); });
+	}
+
+	void shutdown(void) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stop = true;
+		}
+		ready.notify_one();
+		if(thread.joinable()) {
+			thread.join();
+		}
+		cache.close();
+		unlink(path.c_str());
+	}
+
+	void submit(Job *job) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			queue.push_back(job);
+		}
+		ready.notify_one();
+	}
+
+	const std::string &file(void) const {
+		return path;
+	}
+
+private:
+	void run(void) {
+		for(;;) {
+			Job *job;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				ready.wait(guard, [this] { return stop || !queue.empty(); });
+				if(queue.empty()) {
+					return;
+				}
+				job = queue.front();
+				queue.pop_front();
+			}
+			serve(*job);
+
+			// Notify under the lock: the job may go away as soon as
+			// its connection thread sees done
+
+			std::lock_guard<std::mutex> guard(job->lock);
+			job->done = true;
+			job->done_cv.notify_one();
+		}
+	}
+
+	// Serve one job from the cache, rendering it on a miss
+
+	void serve(Job &job) {
+
+		// Reset to the pristine engine and apply the sound
+
+		voice = base;
+		for(uint32_t i = 0; i < job.num_params; i++) {
+			ubersaw_param(voice, job.params[i][0], job.params[i][1]);
+		}
+		voice.seed(job.seed);
+
+		uint64_t notes = FNV_OFFSET;
+		hashBytes(notes, job.notes, job.num_notes * sizeof(Note));
+		job.key = RenderCache::key(voice, (uint16_t)(job.notes[0].note << 8), job.frames,
+				job.format, job.seed, notes);
+
+		const uint32_t evicted = cache.stats().evictions;
+		const void *hit = cache.find(job.key, NULL);
+		if(hit) {
+			job.offset = cache.fileOffset(hit);
+			job.hit = true;
+			metrics.hits++;
+			return;
+		}
+		metrics.misses++;
+
+		void *out = cache.insert(job.key, job.frames, job.format);
+		metrics.evictions += cache.stats().evictions - evicted;
+		if(!out) {
+			job.error = "render does not fit in the cache";
+			return;
+		}
+
+		const double t0 = now();
+		render(job, out);
+		cache.commit();
+		metrics.render_ns += (uint64_t)((now() - t0) * 1e9);
+		metrics.frames_rendered += job.frames;
+
+		job.offset = cache.fileOffset(out);
+		job.hit = false;
+	}
+
+	// Play the note sequence straight into the mapping
+
+	void render(const Job &job, void *out) {
+
+		user_osc_param_t params;
+		memset(&params, 0, sizeof(params));
+
+		uint32_t pos = 0;
+		for(uint32_t n = 0; n < job.num_notes; n++) {
+			const Note &note = job.notes[n];
+			params.pitch = (uint16_t)(note.note << 8);
+			ubersaw_note_on(voice);
+			for(uint32_t t = 0; t < note.frames; ) {
+				uint32_t frames = note.frames - t;
+				if(frames > ENGINE_FRAMES) {
+					frames = ENGINE_FRAMES;
+				}
+				if(t < note.gate && t + frames > note.gate) {
+					frames = note.gate - t; 	// Split the block at note off
+				}
+				if(t == note.gate) {
+					ubersaw_note_off(voice);
+				}
+				if(job.format == k_cache_f32_stereo) {
+					float *y = (float *)out + 2 * (pos + t);
+					ubersaw_cycle_stereo(voice, &params, y, y + 1, 2, frames);
+				}
+				else {
+					ubersaw_cycle(voice, &params, (q31_t *)out + pos + t, frames);
+				}
+				t += frames;
+			}
+			pos += note.frames;
+		}
+	}
+
+	UberSaw 				base;		// Constructed once, copied per job
+	UberSaw 				voice;
+	RenderCache 			cache;
+	std::string 			path;
+	std::thread 			thread;
+	std::mutex 				lock;
+	std::condition_variable ready;
+	std::deque<Job *> 		queue;
+	bool 					stop;
+};
+
+static Worker *workers[MAX_WORKERS];
+static uint32_t num_workers;
+
+/* // =========================================================
+* Parse a RENDER line (after the command word). Returns NULL
+* or the reason it was rejected.
+*/ // =========================================================
+
+static const char *parseJob(char *line, Job &job) {
+
+	job.seed = RAND_SEED;
+	job.format = k_cache_q31;
+	job.num_params = 0;
+	job.num_notes = 0;
+	job.frames = 0;
+
+	char *save = NULL;
+	for(char *tok = strtok_r(line, " \t", &save); tok; tok = strtok_r(NULL, " \t", &save)) {
+
+		char *value = strchr(tok, '=');
+		if(!value) {
+			return "expected name=value";
+		}
+		*value++ = '\0';
+
+		if(strcmp(tok, "seed") == 0) {
+			job.seed = (uint32_t)strtoul(value, NULL, 0);
+		}
+		else if(strcmp(tok, "format") == 0) {
+			if(strcmp(value, "mono") == 0) {
+				job.format = k_cache_q31;
+			}
+			else if(strcmp(value, "stereo") == 0) {
+				job.format = k_cache_f32_stereo;
+			}
+			else {
+				return "format is mono or stereo";
+			}
+		}
+		else if(strcmp(tok, "params") == 0) {
+			char *item_save = NULL;
+			for(char *item = strtok_r(value, ",", &item_save); item; item = strtok_r(NULL, ",", &item_save)) {
+				unsigned index, v;
+				if(sscanf(item, "%u:%u", &index, &v) != 2 || index > 0xFFFF || v > 0xFFFF) {
+					return "params are <index>:<value>";
+				}
+				if(job.num_params == MAX_JOB_PARAMS) {
+					return "too many params";
+				}
+				job.params[job.num_params][0] = (uint16_t)index;
+				job.params[job.num_params][1] = (uint16_t)v;
+				job.num_params++;
+			}
+		}
+		else if(strcmp(tok, "notes") == 0) {
+			char *item_save = NULL;
+			for(char *item = strtok_r(value, ",", &item_save); item; item = strtok_r(NULL, ",", &item_save)) {
+				unsigned note, frames, gate;
+				const int n = sscanf(item, "%u:%u:%u", &note, &frames, &gate);
+				if(n < 2 || note > 127 || frames == 0) {
+					return "notes are <note>:<frames>[:<gate>]";
+				}
+				if(job.num_notes == MAX_JOB_NOTES) {
+					return "too many notes";
+				}
+				if(frames > MAX_JOB_FRAMES - job.frames) {
+					return "job too long";
+				}
+				Note &nt = job.notes[job.num_notes++];
+				nt.note = (uint16_t)note;
+				nt.frames = frames;
+				nt.gate = (n == 3 && gate < frames) ? gate : frames;
+				job.frames += frames;
+			}
+		}
+		else {
+			return "unknown field";
+		}
+	}
+
+	return job.num_notes ? NULL : "no notes";
+}
+
+// =========================================================
+// Requests
+// =========================================================
+
+static void sendAll(int fd, const char *buf, size_t size) {
+	while(size) {
+		const ssize_t n = send(fd, buf, size, MSG_NOSIGNAL);
+		if(n <= 0) {
+			return;
+		}
+		buf += n;
+		size -= (size_t)n;
+	}
+}
+
+static void serveRender(int fd, char *args) {
+
+	const double t0 = now();
+	static thread_local Job job;
+
+	char reply[512];
+	const char *error = parseJob(args, job);
+	if(!error) {
+		uint64_t h = FNV_OFFSET;
+		hashBytes(h, &job.seed, sizeof(job.seed));
+		hashBytes(h, &job.format, sizeof(job.format));
+		hashBytes(h, job.params, job.num_params * sizeof(job.params[0]));
+		hashBytes(h, job.notes, job.num_notes * sizeof(Note));
+
+		job.error = NULL;
+		job.worker = (uint32_t)(h % num_workers);
+		job.done = false;
+		workers[job.worker]->submit(&job);
+
+		std::unique_lock<std::mutex> guard(job.lock);
+		job.done_cv.wait(guard, [] { return job.done; });
+		error = job.error;
+	}
+
+	if(error) {
+		metrics.errors++;
+		snprintf(reply, sizeof(reply), "ERR %s\n", error);
+	}
+	else {
+		metrics.jobs++;
+		metrics.frames_served += job.frames;
+		snprintf(reply, sizeof(reply), "OK %s %llu %u %016llx %s\n",
+				workers[job.worker]->file().c_str(), (unsigned long long)job.offset, job.frames,
+				(unsigned long long)job.key, job.hit ? "hit" : "miss");
+		recordLatency((uint64_t)((now() - t0) * 1e6));
+	}
+	sendAll(fd, reply, strlen(reply));
+}
+
+/* // =========================================================
+* Metrics endpoint. Throughput is averaged since start, the
+* realtime factor is audio rendered per second spent rendering
+* and latency runs from request to reply.
+*/ // =========================================================
+
+static void serveStats(int fd) {
+
+	const double uptime = now() - started;
+	const double render_s = metrics.render_ns * 1e-9;
+	const uint64_t jobs = metrics.jobs;
+
+	char buf[2048];
+	int n = snprintf(buf, sizeof(buf),
+			"workers %u\n"
+			"uptime_seconds %.3f\n"
+			"jobs_total %llu\n"
+			"errors_total %llu\n"
+			"cache_hits_total %llu\n"
+			"cache_misses_total %llu\n"
+			"cache_evictions_total %llu\n"
+			"frames_rendered_total %llu\n"
+			"frames_served_total %llu\n"
+			"jobs_per_second %.3f\n"
+			"frames_served_per_second %.1f\n"
+			"render_realtime_factor %.2f\n"
+			"latency_mean_us %.1f\n"
+			"latency_p50_us %llu\n"
+			"latency_p99_us %llu\n"
+			"latency_max_us %llu\n",
+			num_workers, uptime,
+			(unsigned long long)jobs, (unsigned long long)metrics.errors.load(),
+			(unsigned long long)metrics.hits.load(), (unsigned long long)metrics.misses.load(),
+			(unsigned long long)metrics.evictions.load(),
+			(unsigned long long)metrics.frames_rendered.load(),
+			(unsigned long long)metrics.frames_served.load(),
+			jobs / uptime, metrics.frames_served / uptime,
+			render_s > 0. ? metrics.frames_rendered / (render_s * SAMPLERATE) : 0.,
+			jobs ? (double)metrics.latency_us / jobs : 0.,
+			(unsigned long long)latencyQuantile(0.5), (unsigned long long)latencyQuantile(0.99),
+			(unsigned long long)metrics.latency_max_us.load());
+
+	for(int i = 0; i < LATENCY_BINS && n < (int)sizeof(buf) - 64; i++) {
+		if(metrics.latency[i]) {
+			n += snprintf(buf + n, sizeof(buf) - n, "latency_us_le_%llu %llu\n",
+					(unsigned long long)2 << i, (unsigned long long)metrics.latency[i].load());
+		}
+	}
+	n += snprintf(buf + n, sizeof(buf) - n, "END\n");
+	sendAll(fd, buf, (size_t)n);
+}
+
+// One thread per connection, one request per line
+
+static void serveConnection(int fd) {
+
+	static thread_local char line[MAX_LINE];
+	uint32_t used = 0;
+
+	for(;;) {
+		const ssize_t got = recv(fd, line + used, MAX_LINE - 1 - used, 0);
+		if(got <= 0) {
+			break;
+		}
+		used += (uint32_t)got;
+		line[used] = '\0';
+
+		char *start = line;
+		char *end;
+		while((end = strchr(start, '\n'))) {
+			*end = '\0';
+			if(end > start && end[-1] == '\r') {
+				end[-1] = '\0';
+			}
+			if(strncmp(start, "RENDER", 6) == 0 && (start[6] == ' ' || start[6] == '\0')) {
+				serveRender(fd, start + 6);
+			}
+			else if(strcmp(start, "STATS") == 0) {
+				serveStats(fd);
+			}
+			else if(*start) {
+				sendAll(fd, "ERR unknown request\n", 20);
+			}
+			start = end + 1;
+		}
+
+		used -= (uint32_t)(start - line);
+		memmove(line, start, used);
+		if(used == MAX_LINE - 1) {
+			sendAll(fd, "ERR line too long\n", 18);
+			break;
+		}
+	}
+
+	close(fd);
+}
+
+/* // =========================================================
+* Client: send one request and print the reply. For a render,
+* map the cache file read-only, read the samples in place and
+* check the render was not evicted while reading.
+*/ // =========================================================
+
+static int client(const char *socket_path, int argc, char **argv) {
+
+	std::string request;
+	for(int i = 0; i < argc; i++) {
+		request += (i ? " " : "");
+		request += argv[i];
+	}
+	request += "\n";
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+	if(fd < 0 || connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+		fprintf(stderr, "cannot connect to %s: %s\n", socket_path, strerror(errno));
+		return 1;
+	}
+	sendAll(fd, request.c_str(), request.size());
+	shutdown(fd, SHUT_WR);
+
+	std::string reply;
+	char buf[1024];
+	ssize_t got;
+	while((got = recv(fd, buf, sizeof(buf), 0)) > 0) {
+		reply.append(buf, (size_t)got);
+	}
+	close(fd);
+	fputs(reply.c_str(), stdout);
+
+	char file[256], result[8];
+	unsigned long long offset, key;
+	unsigned frames;
+	if(sscanf(reply.c_str(), "OK %255s %llu %u %llx %7s", file, &offset, &frames, &key, result) != 5) {
+		return strncmp(reply.c_str(), "ERR", 3) == 0 ? 1 : 0;
+	}
+
+	const int cfd = open(file, O_RDONLY);
+	struct stat st;
+	if(cfd < 0 || fstat(cfd, &st) != 0) {
+		fprintf(stderr, "cannot open %s\n", file);
+		return 1;
+	}
+	const uint8_t *map = (const uint8_t *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, cfd, 0);
+	close(cfd);
+	if(map == MAP_FAILED) {
+		return 1;
+	}
+
+	const CacheHeader *header = (const CacheHeader *)map;
+	const CacheEntry *entry = NULL;
+	for(int i = 0; i < CACHE_ENTRIES && !entry; i++) {
+		if(__atomic_load_n(&header->entries[i].key, __ATOMIC_ACQUIRE) == key) {
+			entry = &header->entries[i];
+		}
+	}
+
+	float peak = 0.f;
+	double sum = 0.;
+	uint32_t samples = 0;
+	if(entry) {
+		const uint8_t *pcm = map + offset;
+		if(entry->format == k_cache_f32_stereo) {
+			samples = 2 * frames;
+			for(uint32_t n = 0; n < samples; n++) {
+				const float x = ((const float *)pcm)[n];
+				peak = fmaxf(peak, fabsf(x));
+				sum += (double)x * x;
+			}
+		}
+		else {
+			samples = frames;
+			for(uint32_t n = 0; n < samples; n++) {
+				const float x = q31_to_f32(((const q31_t *)pcm)[n]);
+				peak = fmaxf(peak, fabsf(x));
+				sum += (double)x * x;
+			}
+		}
+	}
+
+	const bool valid = entry && __atomic_load_n(&entry->key, __ATOMIC_ACQUIRE) == key
+			&& sizeof(CacheHeader) + entry->offset == offset;
+	munmap((void *)map, (size_t)st.st_size);
+
+	if(!valid) {
+		fprintf(stderr, "render was evicted before it was read\n");
+		return 1;
+	}
+	printf("read %u samples in place: peak %.3f rms %.3f\n", samples, peak, sqrt(sum / samples));
+	return 0;
+}
+
+// =========================================================
+// Server
+// =========================================================
+
+static volatile sig_atomic_t quit = 0;
+
+static void onSignal(int) {
+	quit = 1;
+}
+
+int main(int argc, char **argv) {
+
+	const char *socket_path = "/tmp/ubersaw.sock";
+	const char *prefix = "/dev/shm/ubersaw";
+	uint32_t count = std::thread::hardware_concurrency();
+	uint64_t cache_mb = 64;
+
+	if(argc >= 3 && strcmp(argv[1], "--client") == 0) {
+		return client(argv[2], argc - 3, argv + 3);
+	}
+
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			socket_path = argv[++i];
+		} else if(strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+			prefix = argv[++i];
+		} else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			count = (uint32_t)atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+			cache_mb = (uint64_t)atoi(argv[++i]);
+		} else {
+			fprintf(stderr, "usage: %s [-s socket] [-m cache prefix] [-j workers] [-c cache MB per worker]\n"
+					"       %s --client <socket> <request...>\n", argv[0], argv[0]);
+			return 1;
+		}
+	}
+	if(count == 0) {
+		count = 1;
+	}
+	if(count > MAX_WORKERS) {
+		count = MAX_WORKERS;
+	}
+
+	// Construct and warm every engine before any worker starts
+	// (the constructor fills the shared detune table)
+
+	for(uint32_t i = 0; i < count; i++) {
+		char path[256];
+		snprintf(path, sizeof(path), "%s-%d-%u.cache", prefix, (int)getpid(), i);
+		Worker *w = new Worker;
+		if(!w->open(path, cache_mb << 20)) {
+			fprintf(stderr, "cannot map %s: %s\n", path, strerror(errno));
+			return 1;
+		}
+		w->warm();
+		workers[num_workers++] = w;
+	}
+	for(uint32_t i = 0; i < num_workers; i++) {
+		workers[i]->start();
+	}
+
+	const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+	unlink(socket_path);
+	if(listener < 0 || bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 16) != 0) {
+		fprintf(stderr, "cannot listen on %s: %s\n", socket_path, strerror(errno));
+		return 1;
+	}
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	started = now();
+	printf("listening on %s, %u workers, %llu MB cache each\n", socket_path, count,
+			(unsigned long long)cache_mb);
+	fflush(stdout);
+
+	while(!quit) {
+		pollfd p = { listener, POLLIN, 0 };
+		if(poll(&p, 1, 200) <= 0) {
+			continue;
+		}
+		const int fd = accept(listener, NULL, NULL);
+		if(fd >= 0) {
+			std::thread(serveConnection, fd).detach();
+		}
+	}
+
+	close(listener);
+	unlink(socket_path);
+	for(uint32_t i = 0; i < num_workers; i++) {
+		workers[i]->shutdown();
+	}
+
+	return 0;
+}
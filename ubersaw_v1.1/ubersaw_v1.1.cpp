@@ -8,56 +8,356 @@
 #include "userosc.h"
 #include "ubersaw_v1.1.hpp"
 
-static UberSaw ubersaw;
+#if defined(UBERSAW_STAGE_TIMING) && defined(UBERSAW_HOST)
+#include <stdio.h>
+#endif
 
-void OSC_INIT(uint32_t platform, uint32_t api) {
-	(void)platform;
-	(void)api;
-}
+HOT_DATA float detune_lut[101];
+HOT_DATA static UberSaw ubersaw;
 
-void OSC_CYCLE(const user_osc_param_t *const params, int32_t *yn, const uint32_t frames){
+#ifdef UBERSAW_STAGE_TIMING
+HOT_DATA static Stages stage_stats;
+#endif
+
+/* // =========================================================
+* Apply a parameter change. Shared by OSC_PARAM and the
+* timestamped event queue consumed in OSC_CYCLE.
+*/ // =========================================================
+
+static inline void setParam(UberSaw &u, uint16_t index, uint16_t value) {
 	
 	// =========================================================
 	
-	// Create local copies of the state and params objects.
+	// Create local copy of the params object.
 	
 	// =========================================================
 	
-	UberSaw::State 			&s = ubersaw.state;
-	const UberSaw::Params 	&p = ubersaw.params;
+	UberSaw::Params &p 	= u.params;
 	
 	// =========================================================
 	
-	// Get the current note being played.
+	// Update parameter values from user control input
 	
 	// =========================================================
 	
-	uint8_t note = params->pitch>>8;
+	switch (index) {
+		case k_user_osc_param_id1:
+			/*
+			* User Parameter 1:
+			* Secondary oscillator A mix control value
+			* Percent parameter: Scale in 0.0 - 1.00
+			*/ 
+			p.mix_A = clip01f(value * 0.01f); 
+			break; 
+			
+		case k_user_osc_param_id2:
+			/*
+			* User Parameter 2:
+			* Secondary oscillator B mix control value
+			* Percent parameter: Scale in 0.0 - 1.00
+			*/ 
+			p.mix_B = clip01f(value * 0.01f); 
+			break; 
+			
+		case k_user_osc_param_id3:
+			/*
+			* User Parameter 3:
+			* Ring mix control value
+			* Percent parameter: Scale in 0.0 - 1.00
+			*/ 
+			p.ringmix = clip01f(value * 0.01f); 
+			break;
+			
+		case k_user_osc_param_id4:
+			/*
+			* User Parameter 4:
+			* Detune linear value (Get curve value from lookup table)
+			* Percent parameter: Scale in 0.0 - 1.00
+			*/ 
+			p.detune = detune_lut[clipminmaxu32(0, value, 100)];
+			break;
+			
+		case k_user_osc_param_id5: 
+			/*
+			* User Parameter 5:
+			* Chord selection value (index into chord_lut)
+			* Percent parameter: range [1-24]
+			* 1-12 just intonation, 13-24 equal temperament
+			* Out of range values clamp to the nearest chord
+			*/ 
+			p.chord = clipminmaxu32(1, value, NUM_CHORDS) - 1;
+			u.state.interval = chord_lut[p.chord];
+			break;
+			
+		case k_user_osc_param_id6:
+			/*
+			* User Parameter 6:
+			* Phase policy on note on
+			* Percent parameter: range [1-3]
+			* Out of range values clamp to the nearest policy
+			*/ 
+			p.phase = clipminmaxu32(1, value, k_num_phase_policies) - 1;
+			break;
+			
+		case k_user_osc_param_shape:
+			/*
+			* A knob value:
+			* Main Oscillator mix control value
+			* 10bit parameter
+			*/ 
+			p.shape = param_val_to_f32(value); break;
+			
+		case k_user_osc_param_shiftshape:
+			/*
+			* B knob value:
+			* Drift control value
+			* 10bit parameter
+			*/ 
+			p.shiftshape = param_val_to_f32(value); break;
+			
+		case k_ubersaw_param_fm:
+			/*
+			* Host parameter:
+			* Depth of the linear FM from oscillators A and B
+			* Percent parameter: Scale in 0.0 - 1.00
+			*/ 
+			p.fm = clip01f(value * 0.01f); 
+			break;
+			
+		case k_ubersaw_param_sync:
+			/*
+			* Host parameter:
+			* Hard sync of the side oscillators to the central one
+			* Switch: 0 off, 1 on
+			*/ 
+			p.sync = value ? 1 : 0;
+			break;
+			
+		default: break;
+	}
+	
+}
+
+/* // =========================================================
+* Apply the secondary oscillator mixes and ring modulation to
+* one channel of the supersaw signal.
+*/ // =========================================================
+
+static inline float mixSecondary(float main_sig, const float sig_A, const float sig_B,
+		const float mix_A, const float mix_B, const float ringmix) {
 	
 	// =========================================================
 	
-	// Update pitches.
+	// Apply mix_A, can set as dominant or inaudible.
+	
+	// =========================================================
+	
+	main_sig = (1.f - mix_A) * main_sig + (mix_A * sig_A);
+	
+	// =========================================================
+	
+	// Apply supermix, can set from dominant to inaudible.
+	
+	// =========================================================
+	
+	main_sig = (1.f - mix_B) * main_sig + (mix_B * sig_B);
 	
 	// =========================================================
 	
-	ubersaw.updatePitch(osc_w0f_for_note(note, params->pitch & 0xFF));
+	// Apply ringmix, can set as dominant or inaudible.
 	
 	// =========================================================
+	
+	return (1.f - ringmix) * main_sig + ringmix * (sig_A * main_sig) + ringmix * (sig_B * main_sig);
+}
 
-    // Get the HPF object.
+/* // =========================================================
+* Side oscillator sample under hard sync. sync_d is the part
+* of the coming frame after the central oscillator wraps, or
+* negative when it does not wrap. On a wrap the side phase
+* jumps back to zero: the step is smoothed with a two sample
+* PolyBLEP, half on this frame and half carried to the next
+* one in blep.
+*/ // =========================================================
+
+static inline float syncSaw(const float phi, const float inc, const float sync_d, float &blep) {
+	
+	float saw = osc_sawf(phi) + blep;
+	blep = ZEROF;
+	
+	if(sync_d >= ZEROF) {
+		
+		// Phase reached at the sync point and the step back to zero
+		
+		float phi_sync = phi + inc * (1.f - sync_d);
+		phi_sync -= (uint32_t)phi_sync;
+		const float step = -2.f * phi_sync;
+		
+		const float after = 1.f - sync_d;
+		saw += 0.5f * step * sync_d * sync_d;
+		blep = -0.5f * step * after * after;
+	}
+	
+	return saw;
+}
 
-    dsp::BiQuad &HPF = ubersaw.HPF;
+// =========================================================
+// Side oscillator sample, free running or hard synced
+// =========================================================
 
-    // =========================================================
+static inline float sideSaw(const bool sync, const float phi, const float inc, const float sync_d,
+		float &blep) {
+	return sync ? syncSaw(phi, inc, sync_d, blep) : osc_sawf(phi);
+}
+
+/* // =========================================================
+* Convert one sample to Q31 with saturation. On the Cortex-M4
+* a VCVT to signed fixed point with 31 fraction bits clamps
+* and truncates in one instruction.
+*/ // =========================================================
+
+static inline q31_t f32ToQ31Sat(float x) {
+#if defined(__arm__) && defined(__ARM_FP)
+	__asm__("vcvt.s32.f32 %0, %0, #31" : "+t"(x));
+	union { float f; q31_t q; } bits;
+	bits.f = x;
+	return bits.q;
+#else
+	return f32_to_q31(clipminmaxf(-1.f, x, Q31_MAX_F));
+#endif
+}
+
+/* // =========================================================
+* Mono output block pass: softclip the declicked frames and
+* convert them to Q31 with saturation. x86 hosts run four
+* frames at a time with SSE2; the Cortex-M4 has no float
+* SIMD, so it runs the scalar loop with the saturating VCVT.
+*/ // =========================================================
+
+HOT_TEXT static inline void softclipToQ31(const float *__restrict x, q31_t *__restrict y,
+		const uint32_t frames) {
 	
-	// Get the current LFO value.
+	uint32_t n = 0;
+	
+#if !defined(__arm__) && defined(__SSE2__)
+	const __m128 c = _mm_set1_ps(SOFTCLIP_C);
+	const __m128 lo = _mm_set1_ps(-1.f);
+	const __m128 hi = _mm_set1_ps(1.f);
+	const __m128 q31_max = _mm_set1_ps(Q31_MAX_F);
+	const __m128 scale = _mm_set1_ps((float)0x7FFFFFFF);
+	
+	for(; n + 4 <= frames; n += 4) {
+		__m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(x + n), lo), hi);
+		v = _mm_sub_ps(v, _mm_mul_ps(c, _mm_mul_ps(_mm_mul_ps(v, v), v)));
+		v = _mm_min_ps(v, q31_max);
+		_mm_storeu_si128((__m128i *)(y + n), _mm_cvttps_epi32(_mm_mul_ps(v, scale)));
+	}
+#endif
+	
+	for(; n < frames; n++) {
+		y[n] = f32ToQ31Sat(osc_softclipf(SOFTCLIP_C, x[n]));
+	}
+}
+
+#ifdef UBERSAW_HOST
+
+/* // =========================================================
+* TPDF dither for host export: add triangular noise of +/-1
+* LSB at the target depth, round and requantise with
+* saturation, so the top bits can be shifted out losslessly.
+*/ // =========================================================
+
+static inline void ditherQ31(q31_t *y, const uint32_t frames, const uint32_t bits,
+		UberSaw::Rand &rand) {
+	
+	const int64_t lsb = (int64_t)1 << (32 - bits);
+	const int64_t mask = ~(lsb - 1);
+	const int64_t max = (int64_t)0x7FFFFFFF & mask;
+	
+	for(uint32_t n = 0; n < frames; n++) {
+		const int64_t noise = (int64_t)(rand.next() >> bits) - (int64_t)(rand.next() >> bits);
+		int64_t v = ((int64_t)y[n] + noise + (lsb >> 1)) & mask;
+		if(v > max) {
+			v = max;
+		}
+		else if(v < -(int64_t)0x80000000) {
+			v = -(int64_t)0x80000000;
+		}
+		y[n] = (q31_t)v;
+	}
+}
+
+#endif
+
+// =========================================================
+// Flush the mono scratch buffer to the output
+// =========================================================
+
+static inline void outputBlock(UberSaw &u, const float *x, q31_t *y, const uint32_t frames) {
+	softclipToQ31(x, y, frames);
+#ifdef UBERSAW_HOST
+	if(u.dither_bits) {
+		ditherQ31(y, frames, u.dither_bits, u.dither);
+	}
+#else
+	(void)u;
+#endif
+}
+
+/* // =========================================================
+* Render frames from the current state and params. OSC_CYCLE
+* may call this several times per block, once for each
+* sub-block between queued parameter events.
+*
+* The mono build collects declicked frames in a scratch
+* buffer and writes them to y as Q31 in block passes of up
+* to OUTPUT_BLOCK frames. The stereo build
+* shares the same phase bank and voice loop, pans the side
+* oscillators and writes float frames to yl and yr, stride
+* apart (1 for planar buffers, 2 for interleaved).
+*/ // =========================================================
+
+template <bool Stereo>
+HOT_TEXT static inline void render(UberSaw &u, const uint32_t frames, q31_t *__restrict y,
+		float *yl, float *yr, const uint32_t stride, const float lfo_inc) {
 	
 	// =========================================================
 	
-	s.lfo = q31_to_f32(params->shape_lfo);
+	// Create local copies of the state and params objects.
+	
+	// =========================================================
+	
+	UberSaw::State 			&s = u.state;
+	const UberSaw::Params 	&p = u.params;
 	
 	// =========================================================
 	
+	// Released to silence: write zeros and leave the state alone.
+	
+	// =========================================================
+	
+	if(u.env.stage == k_env_off) {
+		for(uint32_t n = 0; n < frames; n++) {
+			if(Stereo) {
+				yl[n * stride] = ZEROF;
+				yr[n * stride] = ZEROF;
+			}
+			else {
+				y[n] = 0;
+			}
+		}
+		return;
+	}
+	
+	// =========================================================
+
+    // Get the HPF object.
+
+    dsp::BiQuad &HPF = u.HPF;
+    dsp::BiQuad &HPF_R = u.HPF_R;
+
+    // =========================================================
+	
 	
 	/* =========================================================
 	*
@@ -83,31 +383,84 @@ void OSC_CYCLE(const user_osc_param_t *const params, int32_t *yn, const uint32_t
 	float lfoz = s.lfoz;
 	
 	// =========================================================
+
+	// Get declick gain
 	
-	// Get LFO increment per frame
+	// =========================================================
+	
+	float gain = s.gain;
+	const float gain_inc = s.gain_inc;
+	
+	// =========================================================
+
+	// Get envelope level
 	
 	// =========================================================
 	
-	const float lfo_inc = (s.lfo - lfoz) / frames;
+	float env = u.env.level;
+	const float env_inc = u.env.inc;
 	
 	// =========================================================
 	
-	// Create local copies of parameter object fields.
+	// Create local copies of the modulated mix ramps.
 	
 	// =========================================================
 	
-	const float mix_A = p.mix_A;
-	const float mix_B = p.mix_B;
-	const float ringmix = p.ringmix;
+	UberSaw::Mod &m = u.mod;
+	
+	float mix_A = m.z[k_mod_mix_A];
+	float mix_B = m.z[k_mod_mix_B];
+	float ringmix = m.z[k_mod_ringmix];
+	
+	const float mix_A_inc = m.inc[k_mod_mix_A];
+	const float mix_B_inc = m.inc[k_mod_mix_B];
+	const float ringmix_inc = m.inc[k_mod_ringmix];
 	
 	// =========================================================
 	
-	// Prepare to load buffer.
+	// FM depth ramp, the FM phase update only runs while it is
+	// non-zero.
+	
+	// =========================================================
+	
+	float fm = m.z[k_mod_fm];
+	const float fm_inc = m.inc[k_mod_fm];
+	const bool fm_on = (fm > ZEROF) || (fm_inc != ZEROF);
+	
+	// =========================================================
+	
+	// Quality tier: side voices at full weight and the fading
+	
+	// outer pair, if any.
+	
+	// =========================================================
+	
+	UberSaw::Quality &qt = u.quality;
+	const int voices = qt.voices;
+	const bool fading = qt.fade != 0;
+	float pair_gain = qt.pair_gain;
+	const float pair_inc = qt.pair_inc;
+	
+	// =========================================================
+	
+	// Hard sync state, residuals are dropped while sync is off.
+	
+	// =========================================================
+	
+	const bool sync = p.sync;
+	float blep[NUM_OSC];
+	for(int i = 0; i < NUM_OSC; i++) {
+		blep[i] = sync ? s.blep[i] : ZEROF;
+	}
+	
+	// =========================================================
+	
+	// Mono output scratch buffer.
 	
 	// =========================================================
 	
-	q31_t *__restrict y = (q31_t*)yn; // y is buffer start position.
-	const q31_t *y_e = y + frames; // y_e is buffer end position.
+	float out[OUTPUT_BLOCK];
+	uint32_t out_n = 0;
 	
 	// =========================================================
 	
@@ -115,7 +468,9 @@ void OSC_CYCLE(const user_osc_param_t *const params, int32_t *yn, const uint32_t
 	
 	// =========================================================
 	
-	for (; y != y_e; ) {
+	STAGE_LAP(k_stage_control);
+	
+	for (uint32_t n = 0; n < frames; n++) {
 		
 		// =========================================================
 		
@@ -146,106 +501,189 @@ void OSC_CYCLE(const user_osc_param_t *const params, int32_t *yn, const uint32_t
 		
 		float main_sig = primary_mix * osc_sawf(phi[0]);
 		
+		STAGE_LAP(k_stage_voices);
+		
 		// =========================================================
 		
 		/*
-		* Get secondary sawtooth wave samples for given
-		* phases, then apply secondary mix.
-		* Need to correct amplitude to prevent clipping.
+		* Get sawtooth wave samples for given phases
+		* for Secondary oscillators A and B.
 		*/ 
 		
 		// =========================================================
 		
-		float sig = 0.f;
-		for(int i = 1; i < NUM_OSC; i++) {
-			sig += secondary_mix * osc_sawf(phi[i]);
-		}
+		const float sig_A = 0.5f * osc_sawf(phiA);
+		const float sig_B = 0.5f * osc_sawf(phiB);
 		
-		sig *= AMP_CORRECTION;
-		main_sig += sig;
+		STAGE_LAP(k_stage_chord);
 		
 		// =========================================================
 		
 		/*
-		* Get sawtooth wave sample for given
-		* phase for Secondary oscillator A.
+		* Increment ratio of the supersaw oscillators: linear FM
+		* from oscillators A and B, computed once per frame.
+		* Past full depth the increments go negative (thru-zero).
 		*/ 
 		
 		// =========================================================
 		
-		const float sig_A = 0.5f * osc_sawf(phiA);
-		
-		// =========================================================
-		
-		// Apply mix_A, can set as dominant or inaudible.
-		
-		// =========================================================
-		
-		main_sig = (1.f - mix_A) * main_sig + (mix_A * sig_A);
+		const float ratio = fm_on ? 1.f + FM_INDEX * fm * (sig_A + sig_B) : 1.f;
 		
 		// =========================================================
 		
 		/*
-		* Get sawtooth wave sample for given
-		* phase for Secondary oscillator B.
+		* Hard sync: one wrap test of the central oscillator per
+		* frame, shared by every side oscillator.
 		*/ 
 		
 		// =========================================================
 		
-		const float sig_B = 0.5f * osc_sawf(phiB);
+		float sync_d = -1.f;
+		if(sync) {
+			const float inc = s.w0[0] * ratio;
+			const float next = phi[0] + inc;
+			if(inc > ZEROF && next >= 1.f) {
+				sync_d = (next - 1.f) / inc;
+			}
+		}
 		
 		// =========================================================
 		
-		// Apply supermix, can set from dominant to inaudible.
+		/*
+		* Get secondary sawtooth wave samples for given
+		* phases, then apply secondary mix.
+		* Need to correct amplitude to prevent clipping.
+		*/ 
 		
 		// =========================================================
 		
-		main_sig = (1.f - mix_B) * main_sig + (mix_B * sig_B);
-		
-		// =========================================================
+		float sig = 0.f;
+		float sig_R = 0.f;
+		float amp = AMP_CORRECTION(voices);
+		if(Stereo) {
+			for(int i = 1; i < voices; i++) {
+				const float saw = sideSaw(sync, phi[i], s.w0[i] * ratio, sync_d, blep[i]);
+				sig += s.pan_L[i] * saw;
+				sig_R += s.pan_R[i] * saw;
+			}
+			if(fading) {
+				for(int i = voices; i < voices + 2; i++) {
+					const float saw = pair_gain * sideSaw(sync, phi[i], s.w0[i] * ratio, sync_d, blep[i]);
+					sig += s.pan_L[i] * saw;
+					sig_R += s.pan_R[i] * saw;
+				}
+				amp = 1.f / (voices - 1 + 2.f * pair_gain);
+			}
+			sig *= secondary_mix * amp;
+			sig_R *= secondary_mix * amp;
+		}
+		else {
+			for(int i = 1; i < voices; i++) {
+				sig += secondary_mix * sideSaw(sync, phi[i], s.w0[i] * ratio, sync_d, blep[i]);
+			}
+			if(fading) {
+				for(int i = voices; i < voices + 2; i++) {
+					sig += secondary_mix * pair_gain
+							* sideSaw(sync, phi[i], s.w0[i] * ratio, sync_d, blep[i]);
+				}
+				amp = 1.f / (voices - 1 + 2.f * pair_gain);
+			}
+			sig *= amp;
+		}
 		
-		// Apply ringmix, can set as dominant or inaudible.
+		STAGE_LAP(k_stage_voices);
 		
 		// =========================================================
 		
-		main_sig = (1.f - ringmix) * main_sig + ringmix * (sig_A * main_sig) + ringmix * (sig_B * main_sig);
+		/*
+		* Apply secondary mixes and ring modulation, then the
+		* HPF, declick gain and softclip.
+		* Mono: queue the frame for the Q31 block pass.
+		* Stereo: the centre and secondary oscillators stay centred.
+		*/ 
 		
 		// =========================================================
-
-        // Apply HPF
-
-        // =========================================================
-
-        main_sig = HPF.process_fo(main_sig);
-
-        // =========================================================
-
-		// Softclip signal before sending to buffer
 		
-		// =========================================================
+		if(Stereo) {
+			float sig_L = mixSecondary(main_sig + sig, sig_A, sig_B, mix_A, mix_B, ringmix) + ANTI_DENORMAL;
+			sig_R = mixSecondary(main_sig + sig_R, sig_A, sig_B, mix_A, mix_B, ringmix) + ANTI_DENORMAL;
+			STAGE_LAP(k_stage_ring);
+			
+			sig_L = HPF.process_fo(sig_L);
+			sig_R = HPF_R.process_fo(sig_R);
+			STAGE_LAP(k_stage_hpf);
+			
+			sig_L = osc_softclipf(SOFTCLIP_C, sig_L * gain * env);
+			sig_R = osc_softclipf(SOFTCLIP_C, sig_R * gain * env);
+			STAGE_LAP(k_stage_softclip);
+			
+			*yl = sig_L;
+			*yr = sig_R;
+			yl += stride;
+			yr += stride;
+		}
+		else {
+			main_sig = mixSecondary(main_sig + sig, sig_A, sig_B, mix_A, mix_B, ringmix) + ANTI_DENORMAL;
+			STAGE_LAP(k_stage_ring);
+			
+			main_sig = HPF.process_fo(main_sig);
+			STAGE_LAP(k_stage_hpf);
+			
+			out[out_n++] = main_sig * gain * env;
+			if(out_n == OUTPUT_BLOCK) {
+				STAGE_LAP(k_stage_output);
+				outputBlock(u, out, y, out_n);
+				y += out_n;
+				out_n = 0;
+				STAGE_LAP(k_stage_softclip);
+			}
+		}
 		
-		main_sig = osc_softclipf(0.125f, main_sig);
+		STAGE_LAP(k_stage_output);
 		
 		// =========================================================
 		
-		/*
-		* Add frame to buffer
-		* Must be formatted in Q31 binary fixed point representation
-		*/ 
+		// Update local Central and Side osc phases
 		
 		// =========================================================
 		
-		*(y++) = f32_to_q31(main_sig);
+		if(fm_on) {
+			
+			// =========================================================
+			
+			/*
+			* Linear FM: the increments may be negative (thru-zero),
+			* so the phases wrap in both directions.
+			*/ 
+			
+			// =========================================================
+			
+			for(int i = 0; i < NUM_OSC; i++) {
+				phi[i] += s.w0[i] * ratio;
+				phi[i] -= (int32_t)phi[i];
+				if(phi[i] < ZEROF) {
+					phi[i] += 1.f;
+				}
+			}
+			fm += fm_inc;
+		}
+		else {
+			for(int i = 0; i < NUM_OSC; i++) {
+				phi[i] += s.w0[i];
+				phi[i] -= (uint32_t)phi[i];
+			}
+		}
 		
 		// =========================================================
 		
-		// Update local Central and Side osc phases
+		// Restart the side oscillators from the sync point
 		
 		// =========================================================
 		
-		for(int i = 0; i < NUM_OSC; i++) {
-			phi[i] += s.w0[i];
-			phi[i] -= (uint32_t)phi[i];
+		if(sync_d >= ZEROF) {
+			for(int i = 1; i < NUM_OSC; i++) {
+				phi[i] = s.w0[i] * ratio * sync_d;
+			}
 		}
 		
 		// =========================================================
@@ -275,19 +713,59 @@ void OSC_CYCLE(const user_osc_param_t *const params, int32_t *yn, const uint32_t
 		lfoz += lfo_inc;
 		
 		// =========================================================
-	}
-	
-	// =========================================================
-	
-	// Update global Central and Side osc phases
-	
-	// =========================================================
-	
-	for(int i = 0; i < NUM_OSC; i++) {
-		s.phi[i] = phi[i];
-	}
-	
-	// =========================================================
+		
+		// Update local declick gain
+		
+		// =========================================================
+		
+		gain += gain_inc;
+		
+		// =========================================================
+		
+		// Update local envelope level
+		
+		// =========================================================
+		
+		env += env_inc;
+		
+		// =========================================================
+		
+		// Update local mix ramps
+		
+		// =========================================================
+		
+		mix_A += mix_A_inc;
+		mix_B += mix_B_inc;
+		ringmix += ringmix_inc;
+		pair_gain += pair_inc;
+		
+		STAGE_LAP(k_stage_phase);
+		
+		// =========================================================
+	}
+	
+	// =========================================================
+	
+	// Flush the remaining mono frames
+	
+	// =========================================================
+	
+	if(out_n) {
+		outputBlock(u, out, y, out_n);
+		STAGE_LAP(k_stage_softclip);
+	}
+	
+	// =========================================================
+	
+	// Update global Central and Side osc phases
+	
+	// =========================================================
+	
+	for(int i = 0; i < NUM_OSC; i++) {
+		s.phi[i] = phi[i];
+	}
+	
+	// =========================================================
 	
 	// Update global secondary oscillator phases
 	
@@ -298,6 +776,19 @@ void OSC_CYCLE(const user_osc_param_t *const params, int32_t *yn, const uint32_t
 	
 	// =========================================================
 	
+	// Update global hard sync residuals, clearing those of the
+	
+	// voices not rendered so none is added when they fade in.
+	
+	// =========================================================
+	
+	const int rendered = fading ? voices + 2 : voices;
+	for(int i = 0; i < NUM_OSC; i++) {
+		s.blep[i] = (i < rendered) ? blep[i] : ZEROF;
+	}
+	
+	// =========================================================
+	
 	// Update global final LFO state
 	
 	// =========================================================
@@ -305,105 +796,496 @@ void OSC_CYCLE(const user_osc_param_t *const params, int32_t *yn, const uint32_t
 	s.lfoz = lfoz;
 	
 	// =========================================================
+	
+	// Update global declick gain
+	
+	// =========================================================
+	
+	s.gain = gain;
+	
+	// =========================================================
+	
+	// Update global envelope level
+	
+	// =========================================================
+	
+	u.env.level = env;
+	
+	// =========================================================
+	
+	// Update global mix ramps
+	
+	// =========================================================
+	
+	m.z[k_mod_mix_A] = mix_A;
+	m.z[k_mod_mix_B] = mix_B;
+	m.z[k_mod_ringmix] = ringmix;
+	m.z[k_mod_fm] = fm;
+	qt.pair_gain = pair_gain;
+	
+	// =========================================================
 }
 
-void OSC_NOTEON(const user_osc_param_t *const params) {
-	(void)params;
+void OSC_INIT(uint32_t platform, uint32_t api) {
+	(void)platform;
+	(void)api;
+#if defined(UBERSAW_BUDGET_CHECK) || defined(UBERSAW_GOVERNOR)
+	cyclesInit();
+#endif
 }
 
-void OSC_NOTEOFF(const user_osc_param_t *const params) {
-	(void)params;
-}
+/* // =========================================================
+* Render one block: update control rate state, then render
+* the sub-blocks between queued events and fade boundaries.
+*/ // =========================================================
 
-void OSC_PARAM(uint16_t index, uint16_t value) { 
+template <bool Stereo>
+HOT_TEXT static inline void cycle(UberSaw &u, const user_osc_param_t *const params, int32_t *yn,
+		float *yl, float *yr, const uint32_t stride, const uint32_t frames) {
 	
 	// =========================================================
 	
-	// Create local copies of the state and params objects.
+	// Nothing to render (the ramps below divide by frames).
 	
 	// =========================================================
 	
-	UberSaw::Params &p 	= ubersaw.params;
-	UberSaw::State 	&s 	= ubersaw.state;
+	if(frames == 0) {
+		return;
+	}
 	
 	// =========================================================
 	
-	// Update parameter values from user control input
+	// Start timing the block against the cycle budget.
 	
 	// =========================================================
 	
-	switch (index) {
-		case k_user_osc_param_id1:
-			/*
-			* User Parameter 1:
-			* Secondary oscillator A mix control value
-			* Percent parameter: Scale in 0.0 - 1.00
-			*/ 
-			p.mix_A = clip01f(value * 0.01f); 
-			break; 
-			
-		case k_user_osc_param_id2:
-			/*
-			* User Parameter 2:
-			* Secondary oscillator B mix control value
-			* Percent parameter: Scale in 0.0 - 1.00
-			*/ 
-			p.mix_B = clip01f(value * 0.01f); 
-			break; 
-			
-		case k_user_osc_param_id3:
-			/*
-			* User Parameter 3:
-			* Ring mix control value
-			* Percent parameter: Scale in 0.0 - 1.00
-			*/ 
-			p.ringmix = clip01f(value * 0.01f); 
-			break;
-			
-		case k_user_osc_param_id4:
-			/*
-			* User Parameter 4:
-			* Detune linear value (Get curve value from lookup table)
-			* Percent parameter: Scale in 0.0 - 1.00
-			*/ 
-			p.detune = detune_lut[value];
+#if defined(UBERSAW_BUDGET_CHECK) || defined(UBERSAW_GOVERNOR)
+	const uint32_t start = cyclesNow();
+#endif
+	
+	STAGE_START();
+	
+	// =========================================================
+	
+	// Flush denormals while rendering, restore the mode on exit.
+	
+	// =========================================================
+	
+#ifdef UBERSAW_HOST
+	const FpuGuard fpu(u.flush_denormals);
+#else
+	const FpuGuard fpu;
+#endif
+	
+	// =========================================================
+	
+	// Recover from NaN in the phases or filter state.
+	
+	// =========================================================
+	
+	u.sanitize();
+	
+	// =========================================================
+	
+	// Create local copies of the state object and event queue.
+	
+	// =========================================================
+	
+	UberSaw::State 			&s = u.state;
+	UberSaw::EventQueue 	&q = u.events;
+	
+	// =========================================================
+	
+	// Get the current note being played.
+	
+	// =========================================================
+	
+	uint8_t note = params->pitch>>8;
+	
+	// =========================================================
+	
+	// Get the pitch of the central oscillator.
+	
+	// =========================================================
+	
+	const float w0 = osc_w0f_for_note(note, params->pitch & 0xFF);
+	
+	// =========================================================
+	
+	// Update LFOs and modulation targets (control rate).
+	
+	// =========================================================
+	
+	u.updateLfos(frames);
+	u.updateMod(frames);
+	
+	// =========================================================
+	
+	// Update per-voice drift (control rate).
+	
+	// =========================================================
+	
+	u.updateDrift(frames);
+	
+	// =========================================================
+	
+	// Update pitches.
+	
+	// =========================================================
+	
+	u.updatePitch(w0);
+	
+	// =========================================================
+	
+	// Get the current LFO value.
+	
+	// =========================================================
+	
+	s.lfo = q31_to_f32(params->shape_lfo);
+	
+	// =========================================================
+	
+	// Get LFO increment per frame
+	
+	// =========================================================
+	
+	const float lfo_inc = (s.lfo - s.lfoz) / frames;
+	
+	// =========================================================
+	
+	// Ramp a quality tier change across the block.
+	
+	// =========================================================
+	
+	u.quality.beginBlock(frames);
+	
+	// =========================================================
+	
+	// Ramp the amplitude envelope across the block.
+	
+	// =========================================================
+	
+	u.env.beginBlock(frames);
+	
+	// =========================================================
+	
+	// Prepare to load buffer.
+	
+	// =========================================================
+	
+	q31_t *y = (q31_t*)yn; // y is buffer start position (mono).
+	const uint32_t clock = s.clock; // Frame count at buffer start.
+	uint32_t pos = 0; // Frames rendered so far.
+	
+	/* =========================================================
+	*
+	* Load the buffer, splitting it into sub-blocks at the
+	* offset of each queued parameter event so that changes
+	* land on the exact frame they were stamped with, and at
+	* each stage boundary of the note on declick fade.
+	*
+	* ==========================================================
+	*/ 
+	
+	for (;;) {
+		
+		// =========================================================
+		
+		// Apply every event that is due at the current frame.
+		
+		// =========================================================
+		
+		const uint32_t now = clock + pos;
+		bool changed = false;
+		while(!q.empty() && (int32_t)(q.front().time - now) <= 0) {
+			setParam(u, q.front().index, q.front().value);
+			q.pop();
+			changed = true;
+		}
+		
+		if(changed) {
+			u.stepMod(pos, frames);
+			u.updatePitch(w0);
+		}
+		
+		// =========================================================
+		
+		// Render up to the next event or fade stage boundary,
+		
+		// or to the end of the buffer.
+		
+		// =========================================================
+		
+		uint32_t end = frames;
+		if(!q.empty()) {
+			const int32_t offset = (int32_t)(q.front().time - clock);
+			if(offset <= (int32_t)pos) {
+				continue; // Pushed since the check above, already due.
+			}
+			if(offset < (int32_t)frames) {
+				end = offset;
+			}
+		}
+		
+		if(s.fade_stage != k_fade_none && pos + s.fade < end) {
+			end = pos + s.fade;
+		}
+		
+		STAGE_LAP(k_stage_control);
+		
+		if(Stereo) {
+			render<true>(u, end - pos, y, yl + pos * stride, yr + pos * stride, stride, lfo_inc);
+		}
+		else {
+			render<false>(u, end - pos, y + pos, yl, yr, stride, lfo_inc);
+		}
+		u.updateFade(end - pos);
+		pos = end;
+		
+		if(pos == frames) {
 			break;
-			
-		case k_user_osc_param_id5: 
-			/*
-			* User Parameter 5:
-			* Chord selection value
-			* Percent parameter: range [1-4]
-			*/ 
-			switch(value) {
-				case 1: p.chord = OCTAVE; break;
-				case 2: p.chord = FIFTH; break;
-				case 3: p.chord = MAJOR_3RD; break;
-				case 4: p.chord = MINOR_3RD; break;
-			} break;
-			
-		case k_user_osc_param_id6: break;
-			// User Parameter 6:
-			
-		case k_user_osc_param_shape:
-			/*
-			* A knob value:
-			* Main Oscillator mix control value
-			* 10bit parameter
-			*/ 
-			p.shape = param_val_to_f32(value); break;
-			
-		case k_user_osc_param_shiftshape:
-			/*
-			* B knob value:
-			* Drift control value
-			* 10bit parameter
-			*/ 
-			p.shiftshape = param_val_to_f32(value); break;
-			
-		default: break;
+		}
 	}
 	
 	// =========================================================
+	
+	// Advance the frame clock
+	
+	// =========================================================
+	
+	s.clock = clock + frames;
+	
+#ifdef UBERSAW_STAGE_TIMING
+	stage_stats.frames += frames;
+	STAGE_LAP(k_stage_control);
+#endif
+	
+	// =========================================================
+	
+	// Record block cost against the platform cycle budget
+	
+	// =========================================================
+	
+#ifdef UBERSAW_BUDGET_CHECK
+	u.budget.update(cyclesNow() - start, frames);
+#endif
+	
+	// =========================================================
+	
+	// Settle the envelope, then the quality tier: the governor
+	
+	// and the envelope level pick the tier for the next block.
+	
+	// =========================================================
+	
+	u.env.endBlock();
+	u.quality.cap = (u.env.tier() > u.quality.spread) ? u.env.tier() : u.quality.spread;
+	
+#ifdef UBERSAW_GOVERNOR
+	u.quality.endBlock(cyclesNow() - start, frames);
+#else
+	u.quality.endBlock(0, frames);
+#endif
+	
+	// =========================================================
+}
+
+HOT_TEXT void OSC_CYCLE(const user_osc_param_t *const params, int32_t *yn, const uint32_t frames){
+	cycle<false>(ubersaw, params, yn, NULL, NULL, 0, frames);
+}
+
+#ifdef UBERSAW_BUDGET_CHECK
+
+// =========================================================
+// Cycle budget statistics (host harness or debugger)
+// =========================================================
+
+const UberSaw::Budget &ubersaw_budget(void) {
+	return ubersaw.budget;
+}
+
+#endif
+
+#ifdef UBERSAW_GOVERNOR
+
+// =========================================================
+// Quality governor statistics (host harness or debugger)
+// =========================================================
+
+const UberSaw::Quality &ubersaw_quality(void) {
+	return ubersaw.quality;
 }
 
+#endif
+
+#ifdef UBERSAW_STAGE_TIMING
+
+// =========================================================
+// Per-stage cycle statistics (host harness or debugger)
+// =========================================================
+
+Stages &ubersaw_stages(void) {
+	return stage_stats;
+}
+
+#ifdef UBERSAW_HOST
+
+/* // =========================================================
+* Write the per-stage statistics in folded stack format, one
+* "cycle;render;<stage> <cycles>" line per stage, ready for
+* flamegraph.pl. Returns the number of characters written.
+*/ // =========================================================
+
+uint32_t ubersaw_stage_report(char *buf, uint32_t size) {
+	
+	static const char *const names[k_num_stages] = {
+		"cycle;control",
+		"cycle;render;voices",
+		"cycle;render;chord",
+		"cycle;render;ring",
+		"cycle;render;hpf",
+		"cycle;render;softclip",
+		"cycle;render;output",
+		"cycle;render;phase"
+	};
+	
+	uint32_t len = 0;
+	for(int i = 0; i < k_num_stages && len < size; i++) {
+		const int n = snprintf(buf + len, size - len, "%s %u\n", names[i], stage_stats.cycles[i]);
+		if(n < 0) {
+			break;
+		}
+		len += (uint32_t)n;
+	}
+	return len < size ? len : size - 1;
+}
+
+#endif
+
+#endif
+
+#ifdef UBERSAW_STEREO
+
+/* // =========================================================
+* Stereo render for host builds. Pass separate buffers with a
+* stride of 1 for planar output, or out and out + 1 with a
+* stride of 2 for interleaved output.
+*/ // =========================================================
+
+HOT_TEXT void ubersaw_cycle_stereo(const user_osc_param_t *const params, float *yl, float *yr,
+		const uint32_t stride, const uint32_t frames) {
+	cycle<true>(ubersaw, params, NULL, yl, yr, stride, frames);
+}
+
+// =========================================================
+// Set stereo width of the side oscillators [0-1]
+// =========================================================
+
+void ubersaw_set_width(const float width) {
+	ubersaw.setWidth(width);
+}
+
+#endif
+
+#ifdef UBERSAW_HOST
+
+/* // =========================================================
+* Host engine instances. Every UberSaw is an independent
+* engine, so a host can keep a pool of constructed instances
+* warm and render separate jobs on them, one thread per
+* instance. These mirror the OSC_* hooks, which drive the
+* static instance used on the synth.
+*/ // =========================================================
+
+void ubersaw_param(UberSaw &u, uint16_t index, uint16_t value) {
+	setParam(u, index, value);
+}
+
+void ubersaw_note_on(UberSaw &u) {
+	u.noteOn();
+}
+
+void ubersaw_note_off(UberSaw &u) {
+	u.noteOff();
+}
+
+/* // =========================================================
+* Amplitude envelope: attack time and release time constant
+* in ms, 0 for an instant attack or to hold on note off.
+* Defaults to ENV_ATTACK_MS and ENV_RELEASE_MS.
+*/ // =========================================================
+
+void ubersaw_set_envelope(UberSaw &u, float attack_ms, float release_ms) {
+	u.env.setTimes(attack_ms, release_ms);
+}
+
+void ubersaw_cycle(UberSaw &u, const user_osc_param_t *const params, int32_t *yn,
+		const uint32_t frames) {
+	cycle<false>(u, params, yn, NULL, NULL, 0, frames);
+}
+
+void ubersaw_cycle_stereo(UberSaw &u, const user_osc_param_t *const params, float *yl,
+		float *yr, const uint32_t stride, const uint32_t frames) {
+	cycle<true>(u, params, NULL, yl, yr, stride, frames);
+}
+
+/* // =========================================================
+* TPDF dither the Q31 output of ubersaw_cycle() for export at
+* a lower depth (16 or 24), 0 disables. Shift the output right
+* by 32 - bits to get the exported samples.
+*/ // =========================================================
+
+void ubersaw_set_dither(UberSaw &u, uint32_t bits) {
+	u.dither_bits = bits < 32 ? bits : 0;
+}
+
+/* // =========================================================
+* Snapshots: store the current sound in one of NUM_SNAPSHOTS
+* slots, switch to a stored sound in one call, or morph
+* between two of them with x in [0-1] (once per block at most,
+* the engine ramps the mixes across the block).
+*/ // =========================================================
+
+void ubersaw_store(UberSaw &u, uint32_t slot) {
+	u.storeSnapshot(slot);
+}
+
+void ubersaw_recall(UberSaw &u, uint32_t slot) {
+	u.recallSnapshot(slot);
+}
+
+void ubersaw_morph(UberSaw &u, uint32_t a, uint32_t b, float x) {
+	u.morph(a, b, x);
+}
+
+/* // =========================================================
+* Map a MIDI CC onto its OSC_PARAM index, scaling 0-127 onto
+* the parameter range. Returns false for unmapped controllers.
+*/ // =========================================================
+
+bool ubersaw_midi_cc(UberSaw &u, uint8_t cc, uint8_t value) {
+	for(uint32_t i = 0; i < sizeof(midi_map) / sizeof(midi_map[0]); i++) {
+		const MidiMap &m = midi_map[i];
+		if(m.cc == cc) {
+			setParam(u, m.index, midiMapValue(m, value));
+			return true;
+		}
+	}
+	return false;
+}
+
+#endif
+
+void OSC_NOTEON(const user_osc_param_t *const params) {
+	(void)params;
+	ubersaw.noteOn();
+}
+
+void OSC_NOTEOFF(const user_osc_param_t *const params) {
+	(void)params;
+	ubersaw.noteOff();
+}
+
+void OSC_PARAM(uint16_t index, uint16_t value) { 
+	setParam(ubersaw, index, value);
+}
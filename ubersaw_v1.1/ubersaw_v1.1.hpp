@@ -7,9 +7,256 @@
 
 #pragma once
 
+// Host builds get the stereo path as well
+#if defined(UBERSAW_HOST) && !defined(UBERSAW_STEREO)
+#define UBERSAW_STEREO
+#endif
+
 #include "userosc.h"
 #include "biquad.hpp"
 
+#if !defined(__arm__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+// =========================================================
+// Engine version (manifest 1.1-2): bump whenever the rendered
+// output changes, so host render caches miss old renders
+// =========================================================
+
+#define UBERSAW_ENGINE_VERSION 	0x00010102u
+
+// =========================================================
+// Platform tuning: CPU cycles available per frame
+// (180MHz / 48KHz = 3750, shared with the rest of the
+// firmware and, on polyphonic platforms, with every voice)
+// =========================================================
+
+#ifndef CYCLE_BUDGET
+#if defined(UBERSAW_PLATFORM_PROLOGUE)
+#define CYCLE_BUDGET 	200 		// Up to 16 voices
+#elif defined(UBERSAW_PLATFORM_MINILOGUE_XD)
+#define CYCLE_BUDGET 	600 		// 4 voices
+#else
+#define CYCLE_BUDGET 	1500 		// NTS-1, monophonic
+#endif
+#endif
+
+// =========================================================
+// Cycle histogram: bins of 1/8 of CYCLE_BUDGET, the last
+// bin collects everything from twice the budget upwards
+// =========================================================
+
+#define BUDGET_BINS 		16
+#define BUDGET_BIN_SHIFT 	3
+
+/* // =========================================================
+* Quality governor (UBERSAW_GOVERNOR, make GOVERNOR=1): step
+* down a tier as soon as a block costs more than GOV_HIGH
+* cycles per frame, step back up after GOV_HOLD consecutive
+* blocks under GOV_LOW. The gap between the two is wider than
+* the saving of one tier, so the tiers do not flap.
+*/ // =========================================================
+
+#define GOV_HIGH 	(CYCLE_BUDGET * 7 / 8)
+#define GOV_LOW 	(CYCLE_BUDGET / 2)
+#define GOV_HOLD 	64 			// ~85ms of 64 frame blocks
+
+enum {
+	k_quality_full = 0, 	// 7 supersaw voices
+	k_quality_medium, 		// 5 voices, outer pair dropped
+	k_quality_low, 			// 3 voices
+	k_num_quality_tiers
+};
+
+/* // =========================================================
+* Pitch dependent detune spread: side pair k beats against
+* the centre at k/3 * detune * f0. Once the outermost pair
+* beats faster than SPREAD_MAX_HZ it no longer reads as
+* chorus, only as roughness and aliasing at high notes, so the
+* tier drops it. It comes back once its beat falls under
+* SPREAD_MAX_HZ * SPREAD_HYST. The innermost pair is always
+* kept. Define SPREAD_MAX_HZ as 0 to keep every pair.
+*/ // =========================================================
+
+#ifndef SPREAD_MAX_HZ
+#define SPREAD_MAX_HZ 	250.f
+#endif
+#define SPREAD_HYST 	0.8f
+
+/* // =========================================================
+* Amplitude envelope (UBERSAW_ENVELOPE, make ENVELOPE=1):
+* linear attack on note on, exponential release on note off.
+* As the release falls through ENV_MEDIUM and ENV_LOW the
+* outer supersaw pairs fade out a tier at a time, and under
+* ENV_SILENT the oscillator stops rendering until the next
+* note on. Without the flag note off is ignored and the
+* synth's amp EG shapes the note on its own.
+*/ // =========================================================
+
+#ifdef UBERSAW_ENVELOPE
+#define ENV_ATTACK_MS 	2.f 		// Attack time
+#define ENV_RELEASE_MS 	150.f 		// Release time constant (-90dB after ~1.5s)
+#else
+#define ENV_ATTACK_MS 	0.f 		// Instant
+#define ENV_RELEASE_MS 	0.f 		// Hold on note off
+#endif
+
+#define ENV_MEDIUM 		0.063f 		// -24dB: down to k_quality_medium
+#define ENV_LOW 		0.004f 		// -48dB: down to k_quality_low
+#define ENV_SILENT 		0.00003f 	// -90dB: stop rendering
+
+enum {
+	k_env_attack = 0,
+	k_env_hold,
+	k_env_release,
+	k_env_off
+};
+
+/* // =========================================================
+* Scoped FPU mode: flush denormals to zero for the duration of
+* a render call and restore the caller's mode on exit. Uses
+* FPSCR.FZ on the Cortex-M4 and MXCSR FTZ/DAZ on x86 hosts.
+* Host builds can leave the mode alone (flush false) to
+* measure what the guard saves.
+*/ // =========================================================
+
+#define FPSCR_FZ 		(1u << 24)
+#define MXCSR_FTZ_DAZ 	0x8040u
+
+struct FpuGuard {
+	uint32_t 	saved;
+
+	explicit FpuGuard(const bool flush = true) {
+#if defined(__arm__) && defined(__ARM_FP)
+		__asm__ volatile("vmrs %0, fpscr" : "=r"(saved));
+		if(flush) {
+			__asm__ volatile("vmsr fpscr, %0" : : "r"(saved | FPSCR_FZ));
+		}
+#elif !defined(__arm__) && (defined(__x86_64__) || defined(__i386__))
+		saved = _mm_getcsr();
+		if(flush) {
+			_mm_setcsr(saved | MXCSR_FTZ_DAZ);
+		}
+#else
+		(void)flush;
+		saved = 0;
+#endif
+	}
+
+	~FpuGuard(void) {
+#if defined(__arm__) && defined(__ARM_FP)
+		__asm__ volatile("vmsr fpscr, %0" : : "r"(saved));
+#elif !defined(__arm__) && (defined(__x86_64__) || defined(__i386__))
+		_mm_setcsr(saved);
+#endif
+	}
+};
+
+// =========================================================
+// Anti-denormal offset: a DC offset far below audibility
+// added ahead of the HPF, which removes it again but keeps
+// its recursive state away from the denormal range
+// =========================================================
+
+#define ANTI_DENORMAL 	1.e-020f
+
+// =========================================================
+// Largest sane magnitude of the HPF state
+// =========================================================
+
+#define FILTER_LIMIT 	64.f
+
+// =========================================================
+// Hot path placement: render code, state and tables are
+// gathered into the contiguous .hot section (ld/rules.ld)
+// =========================================================
+
+#if defined(__arm__)
+#define HOT_TEXT 	__attribute__((section(".hot_text"), aligned(16)))
+#define HOT_DATA 	__attribute__((section(".hot_data"), aligned(16)))
+#else
+#define HOT_TEXT
+#define HOT_DATA
+#endif
+
+// =========================================================
+// Cycle counter (DWT on target, TSC on x86 hosts)
+// =========================================================
+
+#if defined(__arm__)
+#define DWT_CTRL 		(*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT 		(*(volatile uint32_t *)0xE0001004)
+#define DEMCR 			(*(volatile uint32_t *)0xE000EDFC)
+#endif
+
+static inline void cyclesInit(void) {
+#if defined(__arm__)
+	DEMCR |= (1u << 24); 	// TRCENA
+	DWT_CTRL |= 1u; 		// CYCCNTENA
+#endif
+}
+
+static inline uint32_t cyclesNow(void) {
+#if defined(__arm__)
+	return DWT_CYCCNT;
+#elif defined(__x86_64__) || defined(__i386__)
+	return (uint32_t)__rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/* // =========================================================
+* Render pipeline stages for per-stage timing. Build with
+* UBERSAW_STAGE_TIMING (make STAGE_TIMING=1) to charge the
+* cycles between consecutive STAGE_LAP() marks to each stage.
+* Otherwise the marks compile to nothing.
+*/ // =========================================================
+
+enum {
+	k_stage_control = 0, 	// Block setup, LFOs, drift, pitch, events
+	k_stage_voices, 		// Supersaw central and side oscillators
+	k_stage_chord, 			// Secondary oscillators A and B
+	k_stage_ring, 			// Secondary mixes and ring modulation
+	k_stage_hpf, 			// HPF.process_fo
+	k_stage_softclip, 		// Softclip (mono: Q31 block pass)
+	k_stage_output, 		// Declick gain and store
+	k_stage_phase, 			// Phase accumulators and ramps
+	k_num_stages
+};
+
+struct Stages {
+	uint32_t 	mark;					// Timestamp of the last lap
+	uint32_t 	frames;					// Frames rendered
+	uint32_t 	cycles[k_num_stages];	// Cycles charged per stage
+
+	inline void reset(void) {
+		frames = 0;
+		for(int i = 0; i < k_num_stages; i++) {
+			cycles[i] = 0;
+		}
+	}
+
+	inline void start(void) {
+		mark = cyclesNow();
+	}
+
+	inline void lap(uint32_t stage) {
+		const uint32_t now = cyclesNow();
+		cycles[stage] += now - mark;
+		mark = now;
+	}
+};
+
+#ifdef UBERSAW_STAGE_TIMING
+#define STAGE_START() 		stage_stats.start()
+#define STAGE_LAP(stage) 	stage_stats.lap(stage)
+#else
+#define STAGE_START()
+#define STAGE_LAP(stage)
+#endif
+
 // =========================================================
 // Number of main oscillators (primary + side)
 // =========================================================
@@ -23,32 +270,173 @@
 #define SIDE_DRIFT 	5.20833333333333e-006f 	// 0.25Hz@48KHz
 #define SUB_DRIFT 	3.125e-006f 			// 0.15Hz@48KHz
 
+// =========================================================
+// Per-voice drift random walk (per frame, scaled per block)
+// =========================================================
+
+#define DRIFT_WALK 		4.e-003f 			// Random walk step per frame
+#define DRIFT_SMOOTH 	2.61799387799149e-004f 	// One-pole, 2Hz@48KHz
+
 // =========================================================
 // Default values
 // =========================================================
 
 #define ZEROF 		0.f
 
+/* // =========================================================
+* Chord intervals for the secondary oscillators: A plays the
+* ratio above the central pitch, B the same interval below.
+* The first 12 entries are just intonation, the next 12 the
+* same intervals in equal temperament. Each entry carries its
+* reciprocal, so the hot path indexes and never divides.
+*/ // =========================================================
+
+#define NUM_INTERVALS 	12
+#define NUM_CHORDS 		(2 * NUM_INTERVALS)
+#define OCTAVE 			0 		// Default chord (just octave)
+
+struct Interval {
+	float 	ratio;
+	float 	recip;
+};
+
+static constexpr Interval chord_lut[NUM_CHORDS] = {
+	{ 2.000000000f, 0.500000000f },	// Octave (2/1)
+	{ 1.500000000f, 0.666666667f },	// Fifth (3/2)
+	{ 1.250000000f, 0.800000000f },	// Major 3rd (5/4)
+	{ 1.200000000f, 0.833333333f },	// Minor 3rd (6/5)
+	{ 1.333333333f, 0.750000000f },	// Fourth (4/3)
+	{ 1.666666667f, 0.600000000f },	// Major 6th (5/3)
+	{ 1.600000000f, 0.625000000f },	// Minor 6th (8/5)
+	{ 1.777777778f, 0.562500000f },	// Minor 7th (16/9)
+	{ 1.875000000f, 0.533333333f },	// Major 7th (15/8)
+	{ 1.125000000f, 0.888888889f },	// Major 2nd (9/8)
+	{ 1.066666667f, 0.937500000f },	// Minor 2nd (16/15)
+	{ 1.406250000f, 0.711111111f },	// Tritone (45/32)
+	{ 2.000000000f, 0.500000000f },	// Octave (2^(12/12))
+	{ 1.498307077f, 0.667419927f },	// Fifth (2^(7/12))
+	{ 1.259921050f, 0.793700526f },	// Major 3rd (2^(4/12))
+	{ 1.189207115f, 0.840896415f },	// Minor 3rd (2^(3/12))
+	{ 1.334839854f, 0.749153538f },	// Fourth (2^(5/12))
+	{ 1.681792831f, 0.594603558f },	// Major 6th (2^(9/12))
+	{ 1.587401052f, 0.629960525f },	// Minor 6th (2^(8/12))
+	{ 1.781797436f, 0.561231024f },	// Minor 7th (2^(10/12))
+	{ 1.887748625f, 0.529731547f },	// Major 7th (2^(11/12))
+	{ 1.122462048f, 0.890898718f },	// Major 2nd (2^(2/12))
+	{ 1.059463094f, 0.943874313f },	// Minor 2nd (2^(1/12))
+	{ 1.414213562f, 0.707106781f } 	// Tritone (2^(6/12))
+};
+
+// =========================================================
+// Phase policy on note on
+// =========================================================
+
+enum {
+	k_phase_free = 0, 	// Phases run freely, note on does nothing
+	k_phase_reset, 		// All phases restart at zero
+	k_phase_random, 	// Each phase restarts at a random value
+	k_num_phase_policies
+};
+
+/* // =========================================================
+* Parameters beyond the six user parameters. The synth only
+* sends the OSC_PARAM ids, so these are set by host drivers
+* (directly, via MIDI CC or as timestamped events).
+*/ // =========================================================
+
+enum {
+	k_ubersaw_param_fm = k_num_user_osc_param_id, 	// FM depth [0-100]
+	k_ubersaw_param_sync, 							// Hard sync off/on [0-1]
+	k_num_ubersaw_params
+};
+
+// =========================================================
+// Linear FM: peak change of the supersaw phase increments at
+// full depth. Above 1 the increments pass through zero.
+// =========================================================
+
+#define FM_INDEX 	2.f
+
+// =========================================================
+// Declick fade length (frames, each of fade out and fade in)
+// =========================================================
+
+#define FADE_FRAMES 	24 		// 0.5ms@48KHz
+
+enum {
+	k_fade_none = 0,
+	k_fade_out,
+	k_fade_in
+};
+
+// =========================================================
+// Default stereo width of the side oscillators (host builds)
+// =========================================================
+
+#define STEREO_WIDTH 	0.5f
+
+// =========================================================
+// Mono output: frames per Q31 block pass, softclip curve and
+// the largest float below 1 (converts to 0x7FFFFF80)
+// =========================================================
+
+#define OUTPUT_BLOCK 	64
+#define SOFTCLIP_C 		0.125f
+#define Q31_MAX_F 		0.99999994f
+
+// =========================================================
+// Amplitude correction for side oscillators (voices counts
+// the central oscillator)
+// =========================================================
+
+#define AMP_CORRECTION(voices) 	(1.f / ((voices) - 1))
+
+// =========================================================
+// Detune curve lookup table (defined once in the engine
+// source, so every translation unit shares the table the
+// UberSaw constructor fills)
+// =========================================================
+
+extern float detune_lut[101];
+
 // =========================================================
-// Ratios for chord options:
+// Parameter snapshot slots
 // =========================================================
 
-#define OCTAVE 		2.f
-#define FIFTH 		1.5f
-#define MAJOR_3RD 	0.75f
-#define MINOR_3RD	1.2f
+#define NUM_SNAPSHOTS 	8
 
 // =========================================================
-// Amplitude correction for side oscillators
+// Parameter event queue size (must be a power of two)
 // =========================================================
 
-#define AMP_CORRECTION 1.f / (NUM_OSC - 1)
+#define EVENT_QUEUE_SIZE 	64
+#define EVENT_QUEUE_MASK 	(EVENT_QUEUE_SIZE - 1)
 
 // =========================================================
-// Detune curve lookup table
+// Modulation engine
 // =========================================================
 
-static float detune_lut[101]; 
+#define NUM_LFO 		3
+#define LFO_MAX_HZ 		1000.f 			// Fastest LFO rate (keeps the phase wrap in range)
+#define RAND_SEED 		0x9E3779B9u 	// Default PRNG seed (must be non-zero)
+
+enum {
+	k_lfo_sine = 0,
+	k_lfo_tri,
+	k_lfo_saw,
+	k_lfo_sh,
+	k_num_lfo_waves
+};
+
+enum {
+	k_mod_detune = 0,
+	k_mod_ringmix,
+	k_mod_mix_A,
+	k_mod_mix_B,
+	k_mod_shiftshape,
+	k_mod_fm,
+	k_num_mod_dest
+};
 
 // =========================================================
 // Ubersaw structure
@@ -63,7 +451,10 @@ struct UberSaw {
 		float 		detune;
 		float   	shape;
 		float   	shiftshape;
-		float 		chord;
+		float 		fm;
+		uint32_t 	sync;
+		uint32_t 	chord;
+		uint32_t 	phase;
     
 		Params(void) :
 			mix_A(ZEROF),
@@ -72,7 +463,10 @@ struct UberSaw {
 			detune(ZEROF),
 			shape(ZEROF),
 			shiftshape(ZEROF),
-			chord(OCTAVE)
+			fm(ZEROF),
+			sync(0),
+			chord(OCTAVE),
+			phase(k_phase_free)
 		{ }
 	};
   
@@ -83,49 +477,855 @@ struct UberSaw {
 		float    w0[NUM_OSC];	// Main oscillator pitches
 		float    w0A;			// Secondary oscillator A pitch
 		float    w0B;			// Secondary oscillator B pitch
+		float    drift[NUM_OSC];	// Main oscillator drift [-1, 1]
+		float    driftA;		// Secondary oscillator A drift
+		float    driftB;		// Secondary oscillator B drift
+		float    walk[NUM_OSC];	// Main oscillator random walk [-1, 1]
+		float    walkA;			// Secondary oscillator A random walk
+		float    walkB;			// Secondary oscillator B random walk
+		float    pan_L[NUM_OSC];	// Side oscillator left gains (stereo)
+		float    pan_R[NUM_OSC];	// Side oscillator right gains (stereo)
+		float    blep[NUM_OSC];	// Pending hard sync PolyBLEP residuals
 		float    lfo;			// LFO initial state (per cycle)
 		float    lfoz;			// LFO final state (per cycle)
-    
+		uint32_t clock;			// Frames rendered since init
+		float    gain;			// Declick gain
+		float    gain_inc;		// Declick gain increment per frame
+		uint32_t fade;			// Frames left in declick fade
+		uint32_t fade_stage;	// Declick fade stage (k_fade_*)
+		Interval interval;		// Chord interval (from params.chord, or morphed)
+
 		State(void) :
 			phiA(ZEROF),
 			phiB(ZEROF),
 			w0A(ZEROF),
 			w0B(ZEROF),
+			driftA(ZEROF),
+			driftB(ZEROF),
+			walkA(ZEROF),
+			walkB(ZEROF),
 			lfo(ZEROF),
-			lfoz(ZEROF)
+			lfoz(ZEROF),
+			clock(0),
+			gain(1.f),
+			gain_inc(ZEROF),
+			fade(0),
+			fade_stage(k_fade_none),
+			interval(chord_lut[OCTAVE])
 		{
 			for(int i = 0; i < NUM_OSC; i++) {
 				w0[i] 	= ZEROF; 
 				phi[i] 	= ZEROF;
+				drift[i] = ZEROF;
+				walk[i] = ZEROF;
+				pan_L[i] = 1.f;
+				pan_R[i] = 1.f;
+				blep[i] = ZEROF;
+			}
+		}
+	};
+
+	/* // =========================================================
+	* Stored sound: the parameters together with the state derived
+	* from them. params.detune already holds the detune curve
+	* value, and the chord interval is resolved from the table.
+	*/ // =========================================================
+
+	struct Snapshot {
+		Params 		params;
+		Interval 	interval;
+
+		Snapshot(void) :
+			interval(chord_lut[OCTAVE])
+		{ }
+	};
+
+	/* // =========================================================
+	* Timestamped parameter change. The time is an absolute frame
+	* count on the same clock as State::clock, so an event can be
+	* queued ahead of the block it lands in.
+	*/ // =========================================================
+
+	struct Event {
+		uint32_t 	time;		// Frame at which the change applies
+		uint16_t 	index;		// OSC_PARAM index
+		uint16_t 	value;		// OSC_PARAM value
+	};
+
+	/* // =========================================================
+	* Preallocated single producer / single consumer ring buffer.
+	* The host pushes events in time order, OSC_CYCLE pops them.
+	* Nothing is allocated and a full queue rejects the event.
+	* Each side publishes its index with a release store after
+	* touching the slot, and reads the other side's index with an
+	* acquire load, so a popped event is always fully written and
+	* a slot is only reused once it has been read.
+	*/ // =========================================================
+
+	struct EventQueue {
+		Event 		events[EVENT_QUEUE_SIZE];
+		uint32_t 	head;	// Next slot to read (consumer)
+		uint32_t 	tail;	// Next slot to write (producer)
+
+		EventQueue(void) :
+			head(0),
+			tail(0)
+		{ }
+
+		// Consumer side
+
+		inline bool empty(void) const {
+			return head == __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+		}
+
+		inline const Event &front(void) const {
+			return events[head & EVENT_QUEUE_MASK];
+		}
+
+		inline void pop(void) {
+			__atomic_store_n(&head, head + 1, __ATOMIC_RELEASE);
+		}
+
+		// Producer side
+
+		inline bool push(uint32_t time, uint16_t index, uint16_t value) {
+			if((tail - __atomic_load_n(&head, __ATOMIC_ACQUIRE)) >= EVENT_QUEUE_SIZE) {
+				return false;
+			}
+			Event &e = events[tail & EVENT_QUEUE_MASK];
+			e.time = time;
+			e.index = index;
+			e.value = value;
+			__atomic_store_n(&tail, tail + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+	};
+
+	/* // =========================================================
+	* Xorshift PRNG. Cheap, seedable and reproducible, used for
+	* sample and hold and any other randomisation in the engine.
+	*/ // =========================================================
+
+	struct Rand {
+		uint32_t 	seed;
+
+		Rand(void) :
+			seed(RAND_SEED)
+		{ }
+
+		inline void setSeed(uint32_t s) {
+			seed = s ? s : RAND_SEED;
+		}
+
+		inline uint32_t next(void) {
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			return seed;
+		}
+
+		// Range [0, 1)
+		inline float unipolar(void) {
+			return (next() >> 8) * 5.9604644775390625e-008f;
+		}
+
+		// Range [-1, 1)
+		inline float bipolar(void) {
+			return (int32_t)next() * 4.656612873077393e-010f;
+		}
+	};
+
+	/* // =========================================================
+	* Control rate LFO driven by a phase accumulator. The value
+	* is evaluated once per block.
+	*/ // =========================================================
+
+	struct Lfo {
+		float 		phi;	// Phase [0-1)
+		float 		w0;		// Phase increment per frame
+		float 		value;	// Output at end of current block [-1, 1]
+		uint32_t 	wave;	// Waveform (k_lfo_*)
+
+		Lfo(void) :
+			phi(ZEROF),
+			w0(ZEROF),
+			value(ZEROF),
+			wave(k_lfo_sine)
+		{ }
+	};
+
+	/* // =========================================================
+	* LFO bank and routing matrix. Each destination takes its
+	* base parameter plus the weighted sum of the LFOs, and the
+	* mix destinations are ramped linearly across the block.
+	* The LFO part at both ends of the block is kept so that an
+	* event can step the base value mid block.
+	*/ // =========================================================
+
+	struct Mod {
+		Lfo 	lfo[NUM_LFO];
+		float 	depth[NUM_LFO][k_num_mod_dest];	// Routing matrix
+		float 	target[k_num_mod_dest];			// Value at end of block
+		float 	z[k_num_mod_dest];				// Current ramped value
+		float 	inc[k_num_mod_dest];			// Ramp increment per frame
+		float 	lfo_from[k_num_mod_dest];		// LFO part at start of block
+		float 	lfo_to[k_num_mod_dest];			// LFO part at end of block
+		Rand 	rand;
+
+		Mod(void) {
+			for(int i = 0; i < NUM_LFO; i++) {
+				for(int j = 0; j < k_num_mod_dest; j++) {
+					depth[i][j] = ZEROF;
+				}
+			}
+			for(int j = 0; j < k_num_mod_dest; j++) {
+				target[j] 	= ZEROF;
+				z[j] 		= ZEROF;
+				inc[j] 		= ZEROF;
+				lfo_from[j] = ZEROF;
+				lfo_to[j] 	= ZEROF;
+			}
+		}
+	};
+
+	/* // =========================================================
+	* Quality tier. The side oscillators are rendered up to
+	* voices; changing tier fades the outer pair in or out over
+	* one block before the voice count changes. The counters
+	* show the governor's decisions. During a release the
+	* envelope caps the tier, and note on restores the tiers it
+	* dropped.
+	*/ // =========================================================
+
+	struct Quality {
+		uint32_t 	tier;		// k_quality_*
+		uint32_t 	voices;		// Supersaw voices at full weight
+		int32_t 	fade;		// Outer pair fading: +1 in, -1 out, 0 none
+		float 		pair_gain;	// Weight of the fading pair
+		float 		pair_inc;	// Weight increment per frame
+		uint32_t 	calm;		// Consecutive blocks under GOV_LOW
+		uint32_t 	cap;		// Best tier the envelope and pitch still need
+		uint32_t 	spread;		// Best tier the detune spread needs at this pitch
+		uint32_t 	shed;		// Tiers dropped for cap
+		uint32_t 	load;		// Cycles per frame, last block
+		uint32_t 	steps_down;	// Tier decreases
+		uint32_t 	steps_up;	// Tier increases
+		uint32_t 	blocks[k_num_quality_tiers];	// Blocks per tier
+
+		Quality(void) :
+			tier(k_quality_full),
+			voices(NUM_OSC),
+			fade(0),
+			pair_gain(ZEROF),
+			pair_inc(ZEROF),
+			calm(0),
+			cap(k_quality_full),
+			spread(k_quality_full),
+			shed(0),
+			load(0),
+			steps_down(0),
+			steps_up(0)
+		{
+			for(int i = 0; i < k_num_quality_tiers; i++) {
+				blocks[i] = 0;
+			}
+		}
+
+		// Start fading to the next tier down or up
+
+		inline void stepDown(void) {
+			tier++;
+			voices -= 2;
+			fade = -1;
+			pair_gain = 1.f;
+		}
+
+		inline void stepUp(void) {
+			tier--;
+			fade = 1;
+			pair_gain = ZEROF;
+		}
+
+		// Note on: bring back at once the tiers the envelope dropped
+		// (the spread still applies)
+
+		inline void restore(void) {
+			cap = spread;
+			if(tier <= cap || shed == 0) {
+				return;
+			}
+			const uint32_t back = (tier - cap < shed) ? tier - cap : shed;
+			tier -= back;
+			shed -= back;
+			voices = NUM_OSC - 2 * tier;
+			fade = 0;
+			pair_gain = ZEROF;
+			pair_inc = ZEROF;
+		}
+
+		/*
+		* Tier the detune spread needs: drop the outermost pair
+		* while it beats faster than the limit (pair 1 beats at
+		* beat Hz, pair k at k * beat).
+		*/
+
+		inline void updateSpread(float beat) {
+			if(SPREAD_MAX_HZ <= ZEROF) {
+				return;
+			}
+			uint32_t t = k_quality_full;
+			while(t < k_quality_low) {
+				const float pair = (float)((NUM_OSC - 1) / 2 - t);
+				const float limit = (t < spread) ? SPREAD_MAX_HZ * SPREAD_HYST : SPREAD_MAX_HZ;
+				if(pair * beat <= limit) {
+					break;
+				}
+				t++;
+			}
+			spread = t;
+		}
+
+		// Ramp the fading pair across the coming block
+
+		inline void beginBlock(uint32_t frames) {
+			pair_inc = fade / (float)frames;
+		}
+
+		// Settle a finished fade, apply the governor, then drop a
+		// tier the envelope or pitch rules out, or bring one back
+
+		inline void endBlock(uint32_t cycles, uint32_t frames) {
+			if(fade > 0) {
+				voices += 2;
+			}
+			fade = 0;
+			pair_inc = ZEROF;
+			blocks[tier]++;
+
+#ifdef UBERSAW_GOVERNOR
+			load = cycles / frames;
+			if(load > GOV_HIGH) {
+				calm = 0;
+				if(tier + 1 < k_num_quality_tiers) {
+					stepDown();
+					steps_down++;
+				}
+			}
+			else if(load < GOV_LOW) {
+				if(++calm >= GOV_HOLD && tier > cap) {
+					calm = 0;
+					stepUp();
+					steps_up++;
+				}
 			}
+			else {
+				calm = 0;
+			}
+#else
+			(void)cycles;
+			(void)frames;
+#endif
+
+			if(fade == 0) {
+				if(tier < cap) {
+					stepDown();
+					shed++;
+				}
+				else if(tier > cap && shed) {
+					stepUp();
+					shed--;
+				}
+			}
+		}
+	};
+
+	/* // =========================================================
+	* Amplitude envelope, advanced once per block and ramped
+	* linearly across it. The attack adds attack per frame up to
+	* 1, the release scales the level by (1 - release) per frame.
+	*/ // =========================================================
+
+	struct Env {
+		uint32_t 	stage;		// k_env_*
+		float 		level;		// Current level [0-1]
+		float 		target;		// Level at the end of the block
+		float 		inc;		// Level increment per frame
+		float 		attack;		// Attack increment per frame, 0 = instant
+		float 		release;	// Release rate per frame, 0 = hold
+
+		Env(void) :
+			stage(k_env_hold),
+			level(1.f),
+			target(1.f),
+			inc(ZEROF)
+		{
+			setTimes(ENV_ATTACK_MS, ENV_RELEASE_MS);
+		}
+
+		// Attack time and release time constant (ms), 0 disables
+
+		inline void setTimes(float attack_ms, float release_ms) {
+			attack = (attack_ms > ZEROF) ? 1000.f / (attack_ms * k_samplerate) : ZEROF;
+			release = (release_ms > ZEROF) ? 1000.f / (release_ms * k_samplerate) : ZEROF;
+		}
+
+		inline void noteOn(void) {
+			if(attack > ZEROF) {
+				stage = k_env_attack;
+			}
+			else {
+				stage = k_env_hold;
+				level = 1.f;
+			}
+		}
+
+		inline void noteOff(void) {
+			if(release > ZEROF && stage != k_env_off) {
+				stage = k_env_release;
+			}
+		}
+
+		// Ramp towards the level due at the end of the coming block
+
+		inline void beginBlock(uint32_t frames) {
+			target = level;
+			if(stage == k_env_attack) {
+				target = level + attack * frames;
+				if(target >= 1.f) {
+					target = 1.f;
+					stage = k_env_hold;
+				}
+			}
+			else if(stage == k_env_release) {
+				const float decay = 1.f - release * frames;
+				target = (decay > ZEROF) ? level * decay : ZEROF;
+			}
+			inc = (target - level) / frames;
+		}
+
+		// Land on the target and stop once the release is silent
+
+		inline void endBlock(void) {
+			level = target;
+			inc = ZEROF;
+			if(stage == k_env_release && level < ENV_SILENT) {
+				stage = k_env_off;
+				level = ZEROF;
+			}
+		}
+
+		// Best quality tier the level still needs
+
+		inline uint32_t tier(void) const {
+			if(stage == k_env_hold || stage == k_env_attack) {
+				return k_quality_full;
+			}
+			return (level < ENV_LOW) ? k_quality_low
+					: (level < ENV_MEDIUM) ? k_quality_medium : k_quality_full;
+		}
+	};
+
+	/* // =========================================================
+	* Cycle budget statistics, updated by OSC_CYCLE when built
+	* with UBERSAW_BUDGET_CHECK (make BUDGET_CHECK=1).
+	*/ // =========================================================
+
+	struct Budget {
+		uint32_t 	last;		// Cycles per frame, last block
+		uint32_t 	peak;		// Cycles per frame, worst block
+		uint32_t 	blocks;		// Blocks rendered
+		uint32_t 	overruns;	// Blocks over CYCLE_BUDGET
+		uint32_t 	histogram[BUDGET_BINS];	// Blocks per load bin
+
+		Budget(void) :
+			last(0),
+			peak(0),
+			blocks(0),
+			overruns(0)
+		{
+			for(int i = 0; i < BUDGET_BINS; i++) {
+				histogram[i] = 0;
+			}
+		}
+
+		inline void update(uint32_t cycles, uint32_t frames) {
+			last = cycles / frames;
+			if(last > peak) {
+				peak = last;
+			}
+			if(last > CYCLE_BUDGET) {
+				overruns++;
+			}
+			uint32_t bin = (last << BUDGET_BIN_SHIFT) / CYCLE_BUDGET;
+			if(bin >= BUDGET_BINS) {
+				bin = BUDGET_BINS - 1;
+			}
+			histogram[bin]++;
+			blocks++;
 		}
 	};
 
 	UberSaw(void) {
 		state = State();
 		params = Params();
+#ifdef UBERSAW_HOST
+		dither_bits = 0;
+		flush_denormals = true;
+#endif
 		buildDetuneTable();
+		randomizePhases();
+		setWidth(STEREO_WIDTH);
+		setLfo(0, k_lfo_sine, 0.5f);
+		setLfo(1, k_lfo_tri, 0.2f);
+		setLfo(2, k_lfo_sh, 4.f);
+	}
+
+	// =========================================================
+	// Set waveform and rate (Hz) of an LFO
+	// =========================================================
+
+	inline void setLfo(uint32_t i, uint32_t wave, float hz) {
+		if(i >= NUM_LFO || wave >= k_num_lfo_waves || !(hz >= ZEROF)) { 	// Also rejects NaN
+			return;
+		}
+		mod.lfo[i].wave = wave;
+		mod.lfo[i].w0 = clipmaxf(hz, LFO_MAX_HZ) * k_samplerate_recipf;
+	}
+
+	// =========================================================
+	// Set routing depth from an LFO to a destination
+	// =========================================================
+
+	inline void setRoute(uint32_t i, uint32_t dest, float depth) {
+		if(i >= NUM_LFO || dest >= k_num_mod_dest || depth != depth) { 	// Rejects NaN
+			return;
+		}
+		mod.depth[i][dest] = clipminmaxf(-1.f, depth, 1.f);
+	}
+
+	// =========================================================
+	// Store the current sound in a snapshot slot, or recall it
+	// =========================================================
+
+	inline void storeSnapshot(uint32_t slot) {
+		if(slot >= NUM_SNAPSHOTS) {
+			return;
+		}
+		snapshots[slot].params = params;
+		snapshots[slot].interval = state.interval;
+	}
+
+	inline void recallSnapshot(uint32_t slot) {
+		if(slot >= NUM_SNAPSHOTS) {
+			return;
+		}
+		params = snapshots[slot].params;
+		state.interval = snapshots[slot].interval;
+	}
+
+	/* // =========================================================
+	* Morph from snapshot a (x = 0) to snapshot b (x = 1). The
+	* continuous parameters and the derived chord interval are
+	* interpolated directly, and the switches take the nearer
+	* snapshot. The next block ramps the mixes to the result
+	* and retunes from the morphed interval, as for any other
+	* parameter change.
+	*/ // =========================================================
+
+	inline void morph(uint32_t a, uint32_t b, float x) {
+		if(a >= NUM_SNAPSHOTS || b >= NUM_SNAPSHOTS) {
+			return;
+		}
+		
+		x = (x > ZEROF) ? clip01f(x) : ZEROF; 	// NaN morphs to a
+		const Params &pa = snapshots[a].params;
+		const Params &pb = snapshots[b].params;
+		
+		params.mix_A 		= linintf(x, pa.mix_A, pb.mix_A);
+		params.mix_B 		= linintf(x, pa.mix_B, pb.mix_B);
+		params.ringmix 		= linintf(x, pa.ringmix, pb.ringmix);
+		params.detune 		= linintf(x, pa.detune, pb.detune);
+		params.shape 		= linintf(x, pa.shape, pb.shape);
+		params.shiftshape 	= linintf(x, pa.shiftshape, pb.shiftshape);
+		params.fm 			= linintf(x, pa.fm, pb.fm);
+		
+		const Params &nearest = (x < 0.5f) ? pa : pb;
+		params.sync 	= nearest.sync;
+		params.chord 	= nearest.chord;
+		params.phase 	= nearest.phase;
+		
+		const Interval &ia = snapshots[a].interval;
+		const Interval &ib = snapshots[b].interval;
+		state.interval.ratio = linintf(x, ia.ratio, ib.ratio);
+		state.interval.recip = linintf(x, ia.recip, ib.recip);
+	}
+
+	/* // =========================================================
+	* Pan the side oscillators alternately left and right. At zero
+	* width both channels equal the mono mix, and the channel
+	* average always does.
+	*/ // =========================================================
+
+	inline void setWidth(float width) {
+		width = (width > ZEROF) ? clip01f(width) : ZEROF; 	// NaN gives zero width
+		for(int i = 1; i < NUM_OSC; i++) {
+			const float pan = (i & 1) ? -width : width;
+			state.pan_L[i] = 1.f - pan;
+			state.pan_R[i] = 1.f + pan;
+		}
+	}
+
+	/* // =========================================================
+	* Seed every PRNG in the engine, so that random start phases,
+	* drift and sample and hold are reproducible for offline renders.
+	*/ // =========================================================
+
+	inline void seed(uint32_t s) {
+		rand.setSeed(s);
+		mod.rand.setSeed(s ^ RAND_SEED);
+		randomizePhases();
+	}
+
+	// =========================================================
+	// Give every oscillator a random start phase
+	// =========================================================
+
+	inline void randomizePhases(void) {
+		for(int i = 0; i < NUM_OSC; i++) {
+			state.phi[i] = rand.unipolar();
+		}
+		state.phiA = rand.unipolar();
+		state.phiB = rand.unipolar();
+	}
+
+	// =========================================================
+	// Restart the phases according to the phase policy
+	// =========================================================
+
+	inline void resetPhases(void) {
+		switch(params.phase) {
+			case k_phase_reset:
+				for(int i = 0; i < NUM_OSC; i++) {
+					state.phi[i] = ZEROF;
+				}
+				state.phiA = ZEROF;
+				state.phiB = ZEROF;
+				break;
+			case k_phase_random:
+				randomizePhases();
+				break;
+			default: break;
+		}
+	}
+
+	/* // =========================================================
+	* Note on: restart the envelope with every voice back, then,
+	* unless free running, fade out from the current gain,
+	* restart the phases at the bottom of the fade and fade in.
+	* The fade is driven block by block from OSC_CYCLE.
+	*
+	* This leaves a 1ms dip in level rather than a crossfade. A
+	* crossfade would have to run the voice loop twice over the
+	* fade, once on the old phases and once on the new, with a
+	* second copy of the phase, BLEP and HPF state. That doubles
+	* the dearest part of the render on every note on, so the
+	* dip is kept on purpose.
+	*/ // =========================================================
+
+	inline void noteOn(void) {
+		env.noteOn();
+		quality.restore();
+		if(params.phase == k_phase_free) {
+			return;
+		}
+		state.fade_stage = k_fade_out;
+		state.fade = FADE_FRAMES;
+		state.gain_inc = -state.gain * (1.f / FADE_FRAMES);
+	}
+
+	// =========================================================
+	// Note off: release the envelope (held unless enabled)
+	// =========================================================
+
+	inline void noteOff(void) {
+		env.noteOff();
+	}
+
+	// =========================================================
+	// Advance the declick fade after rendering frames
+	// =========================================================
+
+	inline void updateFade(uint32_t frames) {
+		
+		if(state.fade_stage == k_fade_none) {
+			return;
+		}
+		
+		state.fade -= frames;
+		if(state.fade > 0) {
+			return;
+		}
+		
+		if(state.fade_stage == k_fade_out) {
+			resetPhases();
+			state.gain = ZEROF;
+			state.fade_stage = k_fade_in;
+			state.fade = FADE_FRAMES;
+			state.gain_inc = 1.f / FADE_FRAMES;
+		}
+		else {
+			state.gain = 1.f;
+			state.fade_stage = k_fade_none;
+			state.gain_inc = ZEROF;
+		}
+	}
+
+	/* // =========================================================
+	* Recover from NaN or runaway values once per block. A phase
+	* outside [0, 1) (NaN included, as every comparison with it
+	* fails) restarts at zero, and a non-finite or exploding HPF
+	* state is flushed.
+	*/ // =========================================================
+
+	static inline void sanitizePhase(float &phi) {
+		if(!(phi >= 0.f && phi < 1.f)) {
+			phi = ZEROF;
+		}
+	}
+
+	static inline void sanitizeFilter(dsp::BiQuad &filter) {
+		if(!(si_fabsf(filter.mZ1) < FILTER_LIMIT && si_fabsf(filter.mZ2) < FILTER_LIMIT)) {
+			filter.flush();
+		}
+	}
+
+	inline void sanitize(void) {
+		for(int i = 0; i < NUM_OSC; i++) {
+			sanitizePhase(state.phi[i]);
+		}
+		sanitizePhase(state.phiA);
+		sanitizePhase(state.phiB);
+		sanitizeFilter(HPF);
+		sanitizeFilter(HPF_R);
+	}
+
+	/* // =========================================================
+	* Advance every LFO by a whole block and evaluate it once.
+	* Sample and hold picks a new value each time its phase wraps.
+	*/ // =========================================================
+
+	inline void updateLfos(uint32_t frames) {
+		
+		for(int i = 0; i < NUM_LFO; i++) {
+			
+			Lfo &lfo = mod.lfo[i];
+			
+			float phi = lfo.phi + lfo.w0 * frames;
+			const bool wrapped = phi >= 1.f;
+			phi -= (uint32_t)phi;
+			lfo.phi = phi;
+			
+			switch(lfo.wave) {
+				case k_lfo_sine: lfo.value = osc_sinf(phi); break;
+				case k_lfo_tri: lfo.value = 1.f - 4.f * si_fabsf(phi - 0.5f); break;
+				case k_lfo_saw: lfo.value = 2.f * phi - 1.f; break;
+				case k_lfo_sh:
+					if(wrapped) {
+						lfo.value = mod.rand.bipolar();
+					}
+					break;
+				default: break;
+			}
+		}
+	}
+
+	/* // =========================================================
+	* Base value of each destination, before modulation.
+	*/ // =========================================================
+
+	inline void getModBase(float *base) {
+		base[k_mod_detune] 		= params.detune;
+		base[k_mod_ringmix] 	= params.ringmix;
+		base[k_mod_mix_A] 		= params.mix_A;
+		base[k_mod_mix_B] 		= params.mix_B;
+		base[k_mod_shiftshape] 	= params.shiftshape;
+		base[k_mod_fm] 			= params.fm;
+	}
+
+	/* // =========================================================
+	* Compute the modulated value of every destination and the
+	* linear ramp that reaches it over the next frames.
+	*/ // =========================================================
+
+	inline void updateMod(uint32_t frames) {
+		
+		float base[k_num_mod_dest];
+		getModBase(base);
+		
+		// =========================================================
+		// Apply the routing matrix and set up the ramps
+		// =========================================================
+		
+		const float frames_recip = 1.f / frames;
+		for(int j = 0; j < k_num_mod_dest; j++) {
+			float lfo = ZEROF;
+			for(int i = 0; i < NUM_LFO; i++) {
+				lfo += mod.depth[i][j] * mod.lfo[i].value;
+			}
+			mod.lfo_from[j] = mod.lfo_to[j];
+			mod.lfo_to[j] = lfo;
+			
+			const float value = base[j] + lfo;
+			mod.target[j] = (value > ZEROF) ? clip01f(value) : ZEROF; 	// NaN safe
+			mod.inc[j] = (mod.target[j] - mod.z[j]) * frames_recip;
+		}
+	}
+
+	/* // =========================================================
+	* An event at frame pos of a block of frames changed the
+	* base values. Step each destination to its new base plus
+	* the LFO part at that frame, and ramp only the LFO part
+	* over the rest of the block.
+	*/ // =========================================================
+
+	inline void stepMod(uint32_t pos, uint32_t frames) {
+		
+		float base[k_num_mod_dest];
+		getModBase(base);
+		
+		const float t = (float)pos / frames;
+		const float rest_recip = 1.f / (frames - pos);
+		for(int j = 0; j < k_num_mod_dest; j++) {
+			const float lfo = mod.lfo_from[j] + (mod.lfo_to[j] - mod.lfo_from[j]) * t;
+			
+			const float now = base[j] + lfo;
+			mod.z[j] = (now > ZEROF) ? clip01f(now) : ZEROF; 	// NaN safe
+			
+			const float value = base[j] + mod.lfo_to[j];
+			mod.target[j] = (value > ZEROF) ? clip01f(value) : ZEROF;
+			mod.inc[j] = (mod.target[j] - mod.z[j]) * rest_recip;
+		}
 	}
   
 	inline void updatePitch(float w0) {
 		
 		// =========================================================
-		// Get phase drift from A knob
+		// Get phase drift from A knob (modulated)
 		// =========================================================
 		
-		const float drift = params.shiftshape;
+		const float drift = mod.target[k_mod_shiftshape];
 		
 		// =========================================================
-		// Get detune curve value (provided by lookup table)
+		// Get detune curve value (lookup table, modulated)
 		// =========================================================
 		
-		const float detune = params.detune;
+		const float detune = mod.target[k_mod_detune];
 		
 		// =========================================================
 		// Set pitch of central oscillator
 		// =========================================================
 		
-		state.w0[0] = w0;
+		state.w0[0] = w0 + (drift * SIDE_DRIFT * state.drift[0]);
 		
 		// =========================================================
 		// Set pitches of side oscillators
@@ -148,9 +1348,9 @@ struct UberSaw {
 			// Detune side oscs and add phase drift
 			// =========================================================
 
-			state.w0[i] = (w0 * detune_down) + (drift * SIDE_DRIFT);
+			state.w0[i] = (w0 * detune_down) + (drift * SIDE_DRIFT * state.drift[i]);
 			
-			state.w0[i + 1] = (w0 * detune_up) + (drift * SIDE_DRIFT);
+			state.w0[i + 1] = (w0 * detune_up) + (drift * SIDE_DRIFT * state.drift[i + 1]);
 			step++;
 		}
 		
@@ -158,14 +1358,51 @@ struct UberSaw {
 		// Set pitch and phase drift of secondary oscillators
 		// =========================================================
 		
-		float chord = params.chord;
-		state.w0A = (chord * w0) + (drift * SUB_DRIFT);
-		state.w0B = ((1.f / chord) * w0) + (drift * SUB_DRIFT);
+		const Interval &chord = state.interval;
+		state.w0A = (chord.ratio * w0) + (drift * SUB_DRIFT * state.driftA);
+		state.w0B = (chord.recip * w0) + (drift * SUB_DRIFT * state.driftB);
 
 		// Set pole for HPF
-        HPF.mCoeffs.setPoleHP((1.f / chord) * w0);
+        HPF.mCoeffs.setPoleHP(chord.recip * w0);
+        HPF_R.mCoeffs = HPF.mCoeffs;
+		
+		// =========================================================
+		// Drop the side pairs that beat too fast at this pitch
+		// =========================================================
+		
+		quality.updateSpread(w0 * detune * (k_samplerate / 3.f));
 	}
 	
+	/* // =========================================================
+	* Step one oscillator's drift: a bounded random walk followed
+	* by a one-pole smoother so the pitch wanders slowly.
+	*/ // =========================================================
+
+	inline void walkDrift(float &walk, float &drift, const float step, const float coef) {
+		walk = clipminmaxf(-1.f, walk + step * rand.bipolar(), 1.f);
+		drift += coef * (walk - drift);
+	}
+
+	/* // =========================================================
+	* Update the drift of every oscillator once per block. Each
+	* oscillator has its own walk, so the voices move independently.
+	* One step per block stands in for a step per frame, so the
+	* wander does not depend on the block size.
+	*/ // =========================================================
+
+	inline void updateDrift(uint32_t frames) {
+		
+		// A walk of n steps spreads by sqrt(n) steps
+		const float step = DRIFT_WALK * sqrtf((float)frames);
+		const float coef = clip01f(DRIFT_SMOOTH * frames);
+		
+		for(int i = 0; i < NUM_OSC; i++) {
+			walkDrift(state.walk[i], state.drift[i], step, coef);
+		}
+		walkDrift(state.walkA, state.driftA, step, coef);
+		walkDrift(state.walkB, state.driftB, step, coef);
+	}
+
 	/* // =========================================================
 	* Implements Adam Szabo's method: First build a detune curve  
 	* lookup table to store detune values and speed up processing time.
@@ -259,7 +1496,108 @@ struct UberSaw {
 		
 	}
 
-	State 	state;
-	Params 	params;
+	State 		state;
+	Params 		params;
+	EventQueue 	events;
+	Mod 		mod;
+	Rand 		rand;
+	Budget 		budget;
+	Quality 	quality;
+	Env 		env;
+	Snapshot 	snapshots[NUM_SNAPSHOTS];
+#ifdef UBERSAW_HOST
+	uint32_t 	dither_bits; 	// TPDF dither target depth, 0 = off
+	Rand 		dither;
+	bool 		flush_denormals; 	// Hold an FpuGuard in OSC_CYCLE
+#endif
     dsp::BiQuad HPF;
+    dsp::BiQuad HPF_R; 	// Right channel HPF (stereo)
 };
+
+#ifdef UBERSAW_BUDGET_CHECK
+
+const UberSaw::Budget &ubersaw_budget(void);
+
+#endif
+
+#ifdef UBERSAW_GOVERNOR
+
+const UberSaw::Quality &ubersaw_quality(void);
+
+#endif
+
+#ifdef UBERSAW_STAGE_TIMING
+
+Stages &ubersaw_stages(void);
+
+#ifdef UBERSAW_HOST
+uint32_t ubersaw_stage_report(char *buf, uint32_t size);
+#endif
+
+#endif
+
+#ifdef UBERSAW_STEREO
+
+// =========================================================
+// Host stereo entry points
+// =========================================================
+
+void ubersaw_cycle_stereo(const user_osc_param_t *const params, float *yl, float *yr,
+		const uint32_t stride, const uint32_t frames);
+void ubersaw_set_width(const float width);
+
+#endif
+
+#ifdef UBERSAW_HOST
+
+// =========================================================
+// MIDI CC to OSC_PARAM mapping (host drivers)
+// =========================================================
+
+struct MidiMap {
+	uint8_t 	cc;			// Controller number
+	uint16_t 	index;		// OSC_PARAM index
+	uint16_t 	min;		// OSC_PARAM value at CC 0
+	uint16_t 	max;		// OSC_PARAM value at CC 127
+};
+
+static const MidiMap midi_map[] = {
+	{ 70, k_user_osc_param_id1, 0, 100 }, 		// Mix A
+	{ 71, k_user_osc_param_id2, 0, 100 }, 		// Mix B
+	{ 72, k_user_osc_param_id3, 0, 100 }, 		// Ring Mix
+	{ 73, k_user_osc_param_id4, 0, 100 }, 		// Detune
+	{ 74, k_user_osc_param_id5, 1, NUM_CHORDS }, 	// Chord
+	{ 75, k_user_osc_param_id6, 1, k_num_phase_policies }, 	// Phase
+	{ 76, k_user_osc_param_shape, 0, 1023 }, 	// Supersaw mix (A knob)
+	{ 77, k_user_osc_param_shiftshape, 0, 1023 }, 	// Drift (B knob)
+	{ 78, k_ubersaw_param_fm, 0, 100 }, 			// FM depth
+	{ 79, k_ubersaw_param_sync, 0, 1 } 				// Hard sync
+};
+
+// OSC_PARAM value for a CC value under m
+
+static inline uint16_t midiMapValue(const MidiMap &m, uint8_t value) {
+	return (uint16_t)(m.min + ((value & 0x7F) * (uint32_t)(m.max - m.min) + 63) / 127);
+}
+
+// =========================================================
+// Host engine instance entry points
+// (construct instances before starting render threads,
+// the constructor fills the shared detune table)
+// =========================================================
+
+void ubersaw_param(UberSaw &u, uint16_t index, uint16_t value);
+void ubersaw_note_on(UberSaw &u);
+void ubersaw_note_off(UberSaw &u);
+void ubersaw_set_envelope(UberSaw &u, float attack_ms, float release_ms);
+void ubersaw_cycle(UberSaw &u, const user_osc_param_t *const params, int32_t *yn,
+		const uint32_t frames);
+void ubersaw_cycle_stereo(UberSaw &u, const user_osc_param_t *const params, float *yl,
+		float *yr, const uint32_t stride, const uint32_t frames);
+void ubersaw_set_dither(UberSaw &u, uint32_t bits);
+void ubersaw_store(UberSaw &u, uint32_t slot);
+void ubersaw_recall(UberSaw &u, uint32_t slot);
+void ubersaw_morph(UberSaw &u, uint32_t a, uint32_t b, float x);
+bool ubersaw_midi_cc(UberSaw &u, uint8_t cc, uint8_t value);
+
+#endif